@@ -54,7 +54,7 @@ bool example_corners(void) {
   __fill_bg(&canvas, BG_COLOR);
 
   PastelShaderContextMonochrome context;
-  PastelShader shader = {pastel_shader_func_monochrome, &context};
+  PastelShader shader = pastel_shader_monochrome(&context);
 
   // Draw corners
   context.color = FG_COLOR;
@@ -85,7 +85,7 @@ bool example_checker(void) {
   __fill_bg(&canvas, BG_COLOR);
 
   PastelShaderContextMonochrome context;
-  PastelShader shader = {pastel_shader_func_monochrome, &context};
+  PastelShader shader = pastel_shader_monochrome(&context);
 
   size_t cols = 10;
   size_t rect_width = WIDTH / cols;
@@ -126,7 +126,7 @@ bool example_circle(void) {
   __fill_bg(&canvas, BG_COLOR);
 
   PastelShaderContextMonochrome context;
-  PastelShader shader = {pastel_shader_func_monochrome, &context};
+  PastelShader shader = pastel_shader_monochrome(&context);
 
   context.color = FG_COLOR;
   Vec2i pos = {WIDTH/2, HEIGHT/2};
@@ -191,7 +191,7 @@ bool example_circle_gradientx(void) {
   Vec2i p = { WIDTH/2, HEIGHT/2 };
   size_t r = { WIDTH/4 } ; 
   PastelShaderContextGradient1D context = { PASTEL_RED, PASTEL_YELLOW, p.x-(int)r, p.x+(int)r};
-  PastelShader shader = { pastel_shader_func_gradient1dx, &context };
+  PastelShader shader = pastel_shader_gradient1dx(&context);
 
   pastel_fill_circle(&canvas, &p, r, shader);
 
@@ -215,7 +215,7 @@ bool asset_circle_gradientx(void) {
   Vec2i p = { canvas.width/2, canvas.height/2 };
   size_t r = { canvas.width/4 } ; 
   PastelShaderContextGradient1D context = { PASTEL_RED, PASTEL_YELLOW, p.x-(int)r, p.x+(int)r};
-  PastelShader shader = { pastel_shader_func_gradient1dx, &context };
+  PastelShader shader = pastel_shader_gradient1dx(&context);
 
   pastel_fill_circle(&canvas, &p, r, shader);
 
@@ -7,9 +7,31 @@
 #define HEIGHT 600
 #define PI 3.1416
 static Color pixels[WIDTH * HEIGHT];
-static PastelShaderContextGradient1D context_grad;
-static PastelShader shader_grady = { pastel_shader_func_gradient1dy, &context_grad };
-static PastelShader shader_gradx = { pastel_shader_func_gradient1dx, &context_grad };
+// The gradients read their colors from lookup tables, built on the first frame.
+static Color lut_grady[HEIGHT + 1];
+static PastelShaderContextGradient1DLut context_grady = {
+  .gradient = { PASTEL_BLUE, PASTEL_YELLOW, 0, HEIGHT },
+  .lut = lut_grady,
+  .lut_capacity = HEIGHT + 1
+};
+static Color lut_gradx[WIDTH + 1];
+static PastelShaderContextGradient1DLut context_gradx = {
+  .gradient = { PASTEL_RED, PASTEL_GREEN, 0, WIDTH },
+  .lut = lut_gradx,
+  .lut_capacity = WIDTH + 1
+};
+static PastelShader shader_grady = {
+  .run = pastel_shader_func_gradient1dy_lut,
+  .context = &context_grady,
+  .flags = PASTEL_SHADER_OPAQUE,
+  .run_span = pastel_shader_func_gradient1dy_lut_span
+};
+static PastelShader shader_gradx = {
+  .run = pastel_shader_func_gradient1dx_lut,
+  .context = &context_gradx,
+  .flags = PASTEL_SHADER_OPAQUE,
+  .run_span = pastel_shader_func_gradient1dx_lut_span
+};
 
 static float angle = 0.0;
 static float freq = 0.1;
@@ -28,34 +50,60 @@ void rotate_point(Vec2i* p) {
   p->y = (sinf(theta)*norm + (float)HEIGHT/2);
 }
 
-Color* render(float dt) {
+// Draw a frame: the background is drawn on the whole canvas, or only on the
+// `previous` damage when the canvas still holds the previous frame.
+static void draw_frame(PastelCanvas* canvas, float dt, const PastelRect* previous, size_t previous_count) {
   angle += dt * (2*PI)*freq;
   if (angle > 2*PI) angle -= 2*PI;
 
-  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
-  {
-    context_grad.c1 = PASTEL_BLUE;
-    context_grad.c2 = PASTEL_YELLOW;
-    context_grad.min = 0;
-    context_grad.max = HEIGHT;
-    pastel_fill(&canvas, shader_grady);
-
-    // Rotate points
-    Vec2i p1, p2, p3;
-    p1.x = 0; p1.y = HEIGHT/2;
-    p2.x = WIDTH*2/3; p2.y = HEIGHT*5/6;
-    p3.x = WIDTH*3/4; p3.y = 0;
-    rotate_point(&p1);
-    rotate_point(&p2);
-    rotate_point(&p3);
-
-    context_grad.c1 = PASTEL_RED;
-    context_grad.c2 = PASTEL_GREEN;
-    context_grad.min = 0;
-    context_grad.max = WIDTH;
-    pastel_fill_triangle(&canvas, &p1, &p2, &p3, shader_gradx);
+  if (previous == NULL) {
+    pastel_fill(canvas, shader_grady);
+  } else {
+    for (size_t i = 0; i < previous_count; ++i) {
+      Vec2i p = { previous[i].x0, previous[i].y0 };
+      Vec2ui dim = { (size_t)(previous[i].x1 - previous[i].x0), (size_t)(previous[i].y1 - previous[i].y0) };
+      pastel_canvas_push_clip(canvas, &p, &dim);
+      pastel_fill(canvas, shader_grady);
+      pastel_canvas_pop_clip(canvas);
+    }
+  }
+
+  // Rotate points
+  Vec2i p1, p2, p3;
+  p1.x = 0; p1.y = HEIGHT/2;
+  p2.x = WIDTH*2/3; p2.y = HEIGHT*5/6;
+  p3.x = WIDTH*3/4; p3.y = 0;
+  rotate_point(&p1);
+  rotate_point(&p2);
+  rotate_point(&p3);
+
+  pastel_fill_triangle(canvas, &p1, &p2, &p3, shader_gradx);
+}
+
+// The canvas lives across frames: only the damage of a frame has to be presented.
+static PastelCanvas canvas;
+static bool first_frame = true;
 
+size_t damage_count(void) {
+  return canvas.damage_count;
+}
+
+PastelRect* damage_rects(void) {
+  return canvas.damage;
+}
+
+Color* render(float dt) {
+  if (first_frame) {
+    canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+    draw_frame(&canvas, dt, NULL, 0);
+    first_frame = false;
+    return canvas.pixels;
   }
+  PastelRect previous[PASTEL_DAMAGE_RECTS];
+  size_t previous_count = canvas.damage_count;
+  for (size_t i = 0; i < previous_count; ++i) previous[i] = canvas.damage[i];
+  pastel_canvas_clear_damage(&canvas);
+  draw_frame(&canvas, dt, previous, previous_count);
   return canvas.pixels;
 }
 
@@ -66,13 +114,71 @@ Color* render(float dt) {
 
 #define return_defer(value) do { result = (value); goto defer; } while (0)
 
+// Frame ring: the render thread draws frame N+1 while the main thread presents frame N,
+// so that rasterization overlaps the wait for vsync instead of adding to it.
+// Each frame is a streaming texture which stays locked while it is drawn, and the
+// canvas renders straight into it. The frames are handed over in ring order with
+// two counters: `produced` frames were drawn by the render thread, `consumed` frames
+// were presented and locked again by the main thread. Frame n may be drawn once
+// n - consumed < FRAMES, and presented once produced > n. Each thread only writes
+// its own counter. The semaphores are only used to sleep until the other thread
+// moved its counter: the counters are checked again after each wake-up.
+// Only the main thread calls the SDL render API.
+#define FRAMES 3
+
+typedef struct {
+  SDL_Texture* texture;
+  PastelCanvas canvas;
+} Frame;
+
+static Frame frames[FRAMES];
+static SDL_atomic_t produced;
+static SDL_atomic_t consumed;
+static SDL_sem* produced_signal;
+static SDL_sem* consumed_signal;
+static SDL_atomic_t running;
+
+static bool lock_frame(Frame* frame) {
+  void *pixels_dst;
+  int pitch;
+  if (SDL_LockTexture(frame->texture, NULL, &pixels_dst, &pitch) < 0) return false;
+  // The rows of the texture are `pitch` bytes apart.
+  frame->canvas = pastel_canvas_create_with_stride(pixels_dst, WIDTH, HEIGHT, pitch/sizeof(Color));
+  return true;
+}
+
+static int render_thread(void* data) {
+  (void)data;
+  Uint32 prev = SDL_GetTicks();
+  // The counters wrap around, the frame index is kept apart
+  for (Uint32 n = 0, i = 0; ; ++n, i = (i + 1) % FRAMES) {
+    // Wait for frame n - FRAMES to be given back
+    while (SDL_AtomicGet(&running) && n - (Uint32)SDL_AtomicGet(&consumed) >= FRAMES) {
+      SDL_SemWait(consumed_signal);
+    }
+    if (!SDL_AtomicGet(&running)) break;
+
+    // Compute Delta Time
+    Uint32 curr = SDL_GetTicks();
+    float dt = (curr - prev)/1000.f;
+    prev = curr;
+
+    // The locked pixels are write-only (they may not hold the previous frame),
+    // so the whole frame is drawn.
+    draw_frame(&frames[i].canvas, dt, NULL, 0);
+    SDL_AtomicSet(&produced, (int)(n + 1));
+    SDL_SemPost(produced_signal);
+  }
+  return 0;
+}
+
 int main(void)
 {
   int result = 0;
 
   SDL_Window *window = NULL;
   SDL_Renderer *renderer = NULL;
-  SDL_Texture *texture = NULL;
+  SDL_Thread *thread = NULL;
 
   {
     if (SDL_Init(SDL_INIT_VIDEO) < 0) return_defer(1);
@@ -80,39 +186,46 @@ int main(void)
     window = SDL_CreateWindow("Pastel", 0, 0, WIDTH, HEIGHT, SDL_WINDOW_SHOWN);
     if (window == NULL) return_defer(1);
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (renderer == NULL) return_defer(1);
 
-    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, WIDTH, HEIGHT);
-    if (texture == NULL) return_defer(1);
+    for (size_t i = 0; i < FRAMES; ++i) {
+      frames[i].texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, WIDTH, HEIGHT);
+      if (frames[i].texture == NULL) return_defer(1);
+      if (!lock_frame(&frames[i])) return_defer(1);
+    }
 
-    Uint32 prev = SDL_GetTicks();
-    for (;;) {
-      // Compute Delta Time
-      Uint32 curr = SDL_GetTicks();
-      float dt = (curr - prev)/1000.f;
-      prev = curr;
+    produced_signal = SDL_CreateSemaphore(0);
+    if (produced_signal == NULL) return_defer(1);
+    consumed_signal = SDL_CreateSemaphore(0);
+    if (consumed_signal == NULL) return_defer(1);
+    SDL_AtomicSet(&produced, 0);
+    SDL_AtomicSet(&consumed, 0);
+    SDL_AtomicSet(&running, 1);
+    thread = SDL_CreateThread(render_thread, "render", NULL);
+    if (thread == NULL) return_defer(1);
 
+    for (Uint32 n = 0, i = 0; ; ++n, i = (i + 1) % FRAMES) {
       // Flush the events
       SDL_Event event;
       while (SDL_PollEvent(&event)) if (event.type == SDL_QUIT) return_defer(0);
 
-      // Render the texture
-      SDL_Rect window_rect = {0, 0, WIDTH, HEIGHT};
-      uint32_t *pixels_src = render(dt);
-      void *pixels_dst;
-      int pitch;
-      if (SDL_LockTexture(texture, &window_rect, &pixels_dst, &pitch) < 0) return_defer(1);
-      for (size_t y = 0; y < HEIGHT; ++y) {
-        memcpy(pixels_dst + y*pitch, pixels_src + y*WIDTH, WIDTH*sizeof(uint32_t));
-      }
-      SDL_UnlockTexture(texture);
+      // Wait for the frame N
+      while ((Uint32)SDL_AtomicGet(&produced) == n) SDL_SemWait(produced_signal);
+      Frame* frame = &frames[i];
+      SDL_UnlockTexture(frame->texture);
 
       // Display the texture
+      SDL_Rect window_rect = {0, 0, WIDTH, HEIGHT};
       if (SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0) < 0) return_defer(1);
       if (SDL_RenderClear(renderer) < 0) return_defer(1);
-      if (SDL_RenderCopy(renderer, texture, &window_rect, &window_rect) < 0) return_defer(1);
+      if (SDL_RenderCopy(renderer, frame->texture, &window_rect, &window_rect) < 0) return_defer(1);
       SDL_RenderPresent(renderer);
+
+      // Give the frame back to the render thread
+      if (!lock_frame(frame)) return_defer(1);
+      SDL_AtomicSet(&consumed, (int)(n + 1));
+      SDL_SemPost(consumed_signal);
     }
   }
 
@@ -124,7 +237,17 @@ defer:
     default:
       fprintf(stderr, "\nSDL ERROR: %s\n", SDL_GetError());
   }
-  if (texture) SDL_DestroyTexture(texture);
+  if (thread) {
+    // Wake the render thread up if it waits for a frame, it then sees it must stop.
+    SDL_AtomicSet(&running, 0);
+    SDL_SemPost(consumed_signal);
+    SDL_WaitThread(thread, NULL);
+  }
+  if (produced_signal) SDL_DestroySemaphore(produced_signal);
+  if (consumed_signal) SDL_DestroySemaphore(consumed_signal);
+  for (size_t i = 0; i < FRAMES; ++i) {
+    if (frames[i].texture) SDL_DestroyTexture(frames[i].texture);
+  }
   if (renderer) SDL_DestroyRenderer(renderer);
   if (window) SDL_DestroyWindow(window);
   SDL_Quit();
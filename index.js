@@ -50,7 +50,13 @@ WebAssembly.instantiateStreaming(fetch('./bin/triangle.wasm'), {
       const pixels = w.instance.exports.render(dt*0.001);
       const buffer = w.instance.exports.memory.buffer;
       const image = new ImageData(new Uint8ClampedArray(buffer, pixels, app.width*app.height*4), app.width);
-      ctx.putImageData(image, 0, 0);
+      // Only put the damage of the frame: rectangles of 4 int32 x0, y0, x1, y1 (bounds included)
+      const count = w.instance.exports.damage_count();
+      const rects = new Int32Array(buffer, w.instance.exports.damage_rects(), 4*count);
+      for (let i = 0; i < count; ++i) {
+        const x0 = rects[4*i], y0 = rects[4*i + 1], x1 = rects[4*i + 2], y1 = rects[4*i + 3];
+        ctx.putImageData(image, 0, 0, x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+      }
 
       window.requestAnimationFrame(loop);
     }
@@ -52,18 +52,14 @@
 // and performs computation on the current pixel.
 // A shader is meant to be applied to every pixel of the image / every pixel of the object being rendered.
 // 
-// TODO: 2D color gradient
 // TODO: Rainbow triangle
 // TODO: SDL to have a window instead of png / web thingy
 // TODO: Immediate mode GUI? Like DearImgui (cimgui) or Nuklear
 // TODO: 3D - Projective camera
 // TODO: Load mesh model
-// TODO: z-buffer
-// TODO: anti-aliasing for lines, triangles, circles
 // TODO: font
 // TODO: terminal rendering
 // TODO: bezier curves
-// TODO: textures
 // TODO: signed distance functions / shape blending / ray marching
 // 
 
@@ -78,6 +74,26 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+// SIMD kernels are picked at compile time from the target flags
+// (e.g -msse2, -mavx2 or -msimd128 for wasm).
+// Define PASTEL_NO_SIMD to only use the scalar code paths.
+#ifndef PASTEL_NO_SIMD
+#if defined(__AVX2__)
+#define PASTEL_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#define PASTEL_SSE2
+#endif
+#if defined(__wasm_simd128__)
+#define PASTEL_WASM_SIMD
+#endif
+#endif // PASTEL_NO_SIMD
+
+// Number of pixels shaded before being blended onto the canvas in one go.
+#ifndef PASTEL_SPAN_CHUNK
+#define PASTEL_SPAN_CHUNK 256
+#endif
+
 // ------------------------------------
 // -------------- MACROS --------------
 // ------------------------------------
@@ -89,6 +105,7 @@
 #define PASTEL_MAX2(max, x, y) do { max = x; if (max < y) max = y; } while (0)
 #define PASTEL_MAX3(max, x, y, z) do { max = x; if (max < y) max = y; if (max < z) max = z; } while (0)
 #define PASTEL_PIXEL(canvas, x, y) (canvas)->pixels[(y) * (canvas)->stride + (x)]
+#define PASTEL_DEPTH(canvas, x, y) (canvas)->depth[(y) * (canvas)->depth_stride + (x)]
 
 typedef uint32_t Color;
 #define PASTEL_RED_CHANNEL(color)   (((color)&0x000000FF)>>(8*0))
@@ -112,11 +129,55 @@ typedef uint32_t Color;
 PASTEL_TYPEDEF_VEC2(size_t, Vec2ui);
 PASTEL_TYPEDEF_VEC2(int, Vec2i);
 
+// A rectangle of pixels, bounds included: [x0, x1] x [y0, y1].
+// It is empty if x0 > x1 or y0 > y1.
+typedef struct {
+  int x0;
+  int y0;
+  int x1;
+  int y1;
+} PastelRect;
+
+// Max number of clip rectangles which can be pushed on a canvas.
+#ifndef PASTEL_CLIP_STACK_SIZE
+#define PASTEL_CLIP_STACK_SIZE 16
+#endif
+
+// Max number of rectangles of the damage of a canvas.
+#ifndef PASTEL_DAMAGE_RECTS
+#define PASTEL_DAMAGE_RECTS 8
+#endif
+
+// Multisample storage of a tile, see `pastel_command_list_set_msaa`.
+typedef struct PastelMsaaTile PastelMsaaTile;
+
 typedef struct {
   Color* pixels;
   size_t width;
   size_t height;
+  // Number of pixels between two rows, at least width: e.g the pitch/4 of a locked texture.
   size_t stride;
+  // Opt-in: pixels are stored with premultiplied alpha (color channels already
+  // multiplied by alpha). Blending then needs no division.
+  // Use `pastel_canvas_unpremultiply` to get back straight alpha, e.g before saving to png.
+  bool premultiplied;
+  // Every primitive only draws inside the clip rectangle.
+  // It is the whole canvas by default, see `pastel_canvas_push_clip`.
+  PastelRect clip;
+  PastelRect clip_stack[PASTEL_CLIP_STACK_SIZE];
+  size_t clip_depth;
+  // Optional depth plane, one float per pixel (NULL by default), see `pastel_canvas_attach_depth`.
+  // Only the `pastel_fill_triangle_depth*` functions read and write it.
+  float* depth;
+  size_t depth_stride;
+  // Set by the command list while it renders a tile in multisample mode:
+  // the primitives then draw on the samples of the tile instead of the pixels.
+  PastelMsaaTile* msaa;
+  // Damage: every primitive adds the rectangle of pixels it can touch (once clipped),
+  // merged into at most PASTEL_DAMAGE_RECTS rectangles. A front end only has to present
+  // these regions, then calls `pastel_canvas_clear_damage`.
+  PastelRect damage[PASTEL_DAMAGE_RECTS];
+  size_t damage_count;
 } PastelCanvas;
 
 // A shader is a struct which has 2 things:
@@ -124,11 +185,27 @@ typedef struct {
 //   - A shader context which can be required by the shader function.
 //     This context provides parameters to the shader function so that it
 //     can do its computations.
+//   - Flags which describe the colors returned by the shader function.
+//   - Optionally, a span shader function which shades the pixels [x0, x1] of row y
+//     at once into `out` (x1 - x0 + 1 colors). Rasterizers call it once per
+//     covered segment of a row instead of calling `run` for every pixel.
+//     When it is NULL, `run` is called for each pixel of the span.
 typedef struct {
   Color (*run)(int x, int y, void*);
   void* context;
+  uint32_t flags;
+  void (*run_span)(int x0, int x1, int y, Color* out, void*);
 } PastelShader;
 
+// Shader flags
+#define PASTEL_SHADER_PREMULTIPLIED (1u << 0) // the shader returns premultiplied alpha colors
+#define PASTEL_SHADER_CONSTANT      (1u << 1) // the shader returns the same color for every pixel
+#define PASTEL_SHADER_OPAQUE        (1u << 2) // the shader only returns opaque colors (alpha 0xFF)
+// Rasterizers use these flags to skip work:
+//   - a constant shader is run once per span. If its color is opaque, the span is
+//     written with wide stores, without blending.
+//   - the colors of an opaque shader replace the pixels of the canvas without blending.
+
 // ----------------------------------------
 // -------------- FUNCTIONS ---------------
 // ----------------------------------------
@@ -136,12 +213,81 @@ typedef struct {
 // @brief Create a canvas: image with its width, height and stride (width if row-major, height if column-major).
 PASTELDEF PastelCanvas pastel_canvas_create(Color* pixels, size_t pixels_width, size_t pixels_height);
 
+// @brief Create a canvas over rows of `stride` pixels, of which only the first `pixels_width`
+// are drawn on, e.g to render straight into a locked texture or a sub-image of a bigger one.
+PASTELDEF PastelCanvas pastel_canvas_create_with_stride(Color* pixels, size_t pixels_width, size_t pixels_height, size_t stride);
+
+// @brief Restrict drawing to the pixels that `pastel_fill_rect(canvas, p, dim_rect, ...)`
+// would cover, intersected with the current clip rectangle.
+// The previous clip rectangle is saved and is restored by `pastel_canvas_pop_clip`.
+// @return false if the clip stack is full (the clip rectangle is then unchanged).
+PASTELDEF bool pastel_canvas_push_clip(PastelCanvas* canvas, const Vec2i* p, const Vec2ui* dim_rect);
+
+// @brief Restore the clip rectangle saved by the last `pastel_canvas_push_clip`.
+PASTELDEF void pastel_canvas_pop_clip(PastelCanvas* canvas);
+
+// @brief Add a rectangle (bounds included, clipped to the canvas) to the damage of the canvas,
+// e.g the whole canvas for the first frame or after writing the pixels directly.
+// A rectangle which overlaps another one enough to not grow their total area is merged with it.
+// When the PASTEL_DAMAGE_RECTS rectangles are used, it is merged with the one it grows the least.
+PASTELDEF void pastel_canvas_add_damage(PastelCanvas* canvas, const PastelRect* rect);
+
+// @brief Empty the damage of the canvas, e.g once it is presented.
+PASTELDEF void pastel_canvas_clear_damage(PastelCanvas* canvas);
+
+// @brief Attach a depth plane to the canvas: `depth` holds canvas->height rows
+// of `depth_stride` floats, owned by the caller. NULL detaches it.
+PASTELDEF void pastel_canvas_attach_depth(PastelCanvas* canvas, float* depth, size_t depth_stride);
+
+// @brief Set the depth of every pixel of the canvas to z, e.g INFINITY at the start of a frame.
+PASTELDEF void pastel_canvas_clear_depth(PastelCanvas* canvas, float z);
+
+// @brief Create a shader from a shader function and its context, with no flags.
+PASTELDEF PastelShader pastel_shader_create(Color (*run)(int x, int y, void*), void* context);
+
+// @brief Run a shader on pixel (x, y), with `run` or with `run_span` on a single pixel span.
+PASTELDEF Color pastel_shader_run(PastelShader shader, int x, int y);
+
+// @brief Run a shader on the pixels [x0, x1] of row y, with `run_span` or
+// by calling `run` for each pixel. `out` receives x1 - x0 + 1 colors.
+PASTELDEF void pastel_shader_run_span(PastelShader shader, int x0, int x1, int y, Color* out);
+
 // @brief Alpha-blends two colors.
 // See https://fr.wikipedia.org/wiki/Alpha_blending
 // @param c1 the color of object on the lower layer
 // @param c2 the color of object on the upper layer
 PASTELDEF void pastel_blend_colors(Color* c1, Color c2);
 
+// @brief Alpha-blends a span of `n` colors `src` onto `dst`.
+// Gives the same result as calling `pastel_blend_colors(&dst[i], src[i])` for each pixel,
+// but blends several pixels at once with SSE2/AVX2 (x86-64) or SIMD128 (wasm) when available.
+PASTELDEF void pastel_blend_span(Color* dst, const Color* src, size_t n);
+
+// @brief Convert a straight alpha color to premultiplied alpha, and back.
+PASTELDEF Color pastel_color_premultiply(Color c);
+PASTELDEF Color pastel_color_unpremultiply(Color c);
+
+// @brief Alpha-blends two premultiplied colors: c1 = c2 + c1*(1 - alpha2).
+// No division is needed, the /255 is rounded exactly with shifts.
+PASTELDEF void pastel_blend_colors_premultiplied(Color* c1, Color c2);
+
+// @brief Same as `pastel_blend_span` for premultiplied colors.
+PASTELDEF void pastel_blend_span_premultiplied(Color* dst, const Color* src, size_t n);
+
+// @brief Convert `n` colors from straight to premultiplied alpha (and back).
+// `dst` and `src` can be the same buffer.
+PASTELDEF void pastel_premultiply_span(Color* dst, const Color* src, size_t n);
+PASTELDEF void pastel_unpremultiply_span(Color* dst, const Color* src, size_t n);
+
+// @brief dst[i] = the mean of the 4 colors src[4i .. 4i + 3], rounded, for `n` colors of `dst`:
+// e.g the 4 samples of a pixel, or 2x2 texels stored in Z-order.
+PASTELDEF void pastel_average4_span(Color* dst, const Color* src, size_t n);
+
+// @brief Convert the whole canvas to premultiplied alpha (and back) in place
+// and update its `premultiplied` flag accordingly.
+PASTELDEF void pastel_canvas_premultiply(PastelCanvas* canvas);
+PASTELDEF void pastel_canvas_unpremultiply(PastelCanvas* canvas);
+
 // @brief Fill the entire image buffer with a given shader.
 // This function does *not* blend with the existing canvas.
 // It replaces each pixel of the canvas according to the @param shader.
@@ -172,20 +318,296 @@ PASTELDEF void pastel_draw_line(PastelCanvas* canvas, const Vec2i* p1, const Vec
 // On the CPU, this version is MUCH faster than the AABB ones above (3x faster).
 // However, in practice, on the GPU, it's the AABB one which is implemented.
 // This is simply because you can assign each pixel of the AABB to a GPU core. Parallelism changes a lot (benchmarking is very important).
+// The edges are walked in fixed-point, without divisions per row, and the pixels follow
+// the top-left fill rule: pixels exactly on a top or left edge are drawn, pixels on a bottom
+// or right edge are not. So triangles sharing an edge never blend its pixels twice.
 // @param p1, p2 and p3 the triangle vertices.
 PASTELDEF void pastel_fill_triangle(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader);
 
+// Number of fractional bits of the vertices of `pastel_fill_triangle_subpixel`.
+#ifndef PASTEL_SUBPIXEL_BITS
+#define PASTEL_SUBPIXEL_BITS 4
+#endif
+
+// @brief Same as `pastel_fill_triangle` but the vertices are in fixed-point, with
+// PASTEL_SUBPIXEL_BITS fractional bits: (x, y) is the point (x / 2^PASTEL_SUBPIXEL_BITS, y / 2^PASTEL_SUBPIXEL_BITS).
+// The pixel (x, y) is drawn if the point (x, y) is in the triangle.
+PASTELDEF void pastel_fill_triangle_subpixel(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader);
+
+// @brief Same as `pastel_fill_triangle` with a depth z1, z2 and z3 at each vertex, interpolated
+// over the triangle. With a depth plane attached to the canvas, a pixel is drawn only if
+// its depth is less than the one stored in the plane, which it then replaces.
+// The depth test runs before the shader: hidden pixels are neither shaded nor blended.
+// Without a depth plane, it is `pastel_fill_triangle`.
+PASTELDEF void pastel_fill_triangle_depth(PastelCanvas* canvas, const Vec2i* p1, float z1, const Vec2i* p2, float z2, const Vec2i* p3, float z3, PastelShader shader);
+
+// @brief Same as `pastel_fill_triangle_depth` with subpixel vertices, see `pastel_fill_triangle_subpixel`.
+PASTELDEF void pastel_fill_triangle_depth_subpixel(PastelCanvas* canvas, const Vec2i* p1, float z1, const Vec2i* p2, float z2, const Vec2i* p3, float z3, PastelShader shader);
+
+// @brief Same as `pastel_draw_line` with anti-aliasing (Xiaolin Wu): in each column
+// (or row, for a steep line) the two pixels around the line share its coverage.
+PASTELDEF void pastel_draw_line_aa(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, PastelShader shader);
+
+// @brief Same as `pastel_fill_triangle` with anti-aliasing: pixel (x, y) is the square
+// [x - 0.5, x + 0.5] x [y - 0.5, y + 0.5] and it is covered by the exact area of its intersection
+// with the triangle. Only the pixels on the edges compute a coverage, the inside spans are
+// drawn like `pastel_fill_triangle`.
+// Two triangles sharing an edge both blend it with a partial coverage, so its pixels
+// may remain slightly translucent.
+PASTELDEF void pastel_fill_triangle_aa(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader);
+
+// @brief Same as `pastel_fill_circle` with anti-aliasing: the pixels on the edge are
+// covered by the exact area of their intersection with the disk of center p and radius r.
+PASTELDEF void pastel_fill_circle_aa(PastelCanvas* canvas, const Vec2i* p, size_t r, PastelShader shader);
+
 // @brief Fill a triangle with a given shader.
 // A triangle is 3 points (x0, y0), (x1, y1) and (x2, y2)
 // Convention: the triangles are stored counter-clockwise.
 // This function uses aabb to isolate a rectangle of pixels where the triangle lives.
 // For each pixel in this aabb, it then checks if the pixel is in the triangle.
+// The checks are done on blocks of 8x8 pixels first, so that blocks fully inside or
+// outside of the triangle don't need per-pixel checks.
 // This is what is used in GPUs as it can parallelize better than drawing triangles line by line.
 PASTELDEF void pastel_fill_triangle2_oriented(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader);
 
 // @brief Same as `pastel_fill_triangle_oriented` but the triangle does not need to have an orientation.
 PASTELDEF void pastel_fill_triangle2(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader);
 
+// ------------------------------------------
+// -------------- BATCHES -------------------
+// ------------------------------------------
+// Batches draw many primitives of the same kind in one call, each with its own color.
+// They are structures of arrays: primitive i is made of the i-th element of every array.
+// The primitives are drawn in order, with the same pixels as one call per primitive with
+// a constant shader of its color (straight alpha).
+// The setup of the primitives (bounds, clipping, culling, and for triangles the sort of
+// the vertices by y) is done on chunks of PASTEL_BATCH_CHUNK primitives at once, in
+// branch-free loops the compiler can vectorize. Only the rows are then drawn one primitive at a time.
+#ifndef PASTEL_BATCH_CHUNK
+#define PASTEL_BATCH_CHUNK 64
+#endif
+
+// Rectangles [x, x + w] x [y, y + h], as in `pastel_fill_rect`.
+typedef struct {
+  const int* x;
+  const int* y;
+  const int* w;
+  const int* h;
+  const Color* colors;
+  size_t count;
+} PastelRectBatch;
+
+// Circles of center (x, y) and radius r, as in `pastel_fill_circle`.
+typedef struct {
+  const int* x;
+  const int* y;
+  const int* r;
+  const Color* colors;
+  size_t count;
+} PastelCircleBatch;
+
+// Triangles (x0, y0), (x1, y1), (x2, y2), as in `pastel_fill_triangle`.
+typedef struct {
+  const int* x0;
+  const int* y0;
+  const int* x1;
+  const int* y1;
+  const int* x2;
+  const int* y2;
+  const Color* colors;
+  size_t count;
+} PastelTriangleBatch;
+
+// @brief Fill a batch of rectangles / circles / triangles.
+PASTELDEF void pastel_fill_rects(PastelCanvas* canvas, const PastelRectBatch* batch);
+PASTELDEF void pastel_fill_circles(PastelCanvas* canvas, const PastelCircleBatch* batch);
+PASTELDEF void pastel_fill_triangles(PastelCanvas* canvas, const PastelTriangleBatch* batch);
+
+// ------------------------------------------
+// -------------- MESHES --------------------
+// ------------------------------------------
+// A mesh is an array of vertices and an array of indices into it, 3 indices per triangle.
+// Every vertex is processed once (converted to subpixel coordinates and classified against
+// the clip rectangle) even if it is shared by several triangles, thanks to a small cache of
+// the last PASTEL_MESH_CACHE_SIZE processed vertices (direct-mapped on the index).
+// Triangles entirely on one side of the clip rectangle are skipped.
+// The triangles are filled like `pastel_fill_triangle`: the top-left fill rule draws
+// the pixels of an edge shared by two triangles exactly once.
+// If @param indices is NULL, the vertices are used in order.
+// Triangles with an index >= nverts are skipped.
+#ifndef PASTEL_MESH_CACHE_SIZE
+#define PASTEL_MESH_CACHE_SIZE 32
+#endif
+
+// @brief Draw the triangles (indices[3k], indices[3k + 1], indices[3k + 2]).
+PASTELDEF void pastel_draw_mesh(PastelCanvas* canvas, const Vec2i* verts, size_t nverts, const uint32_t* indices, size_t nidx, PastelShader shader);
+
+// @brief Draw a triangle strip: the triangles (indices[k], indices[k + 1], indices[k + 2]).
+PASTELDEF void pastel_draw_mesh_strip(PastelCanvas* canvas, const Vec2i* verts, size_t nverts, const uint32_t* indices, size_t nidx, PastelShader shader);
+
+// @brief Draw a triangle fan: the triangles (indices[0], indices[k + 1], indices[k + 2]).
+PASTELDEF void pastel_draw_mesh_fan(PastelCanvas* canvas, const Vec2i* verts, size_t nverts, const uint32_t* indices, size_t nidx, PastelShader shader);
+
+
+// ----------------------------------------
+// -------------- THREADS -----------------
+// ----------------------------------------
+// Opt-in: define PASTEL_THREADS (and link with -pthread) to get a small
+// thread pool and parallel versions of the fill functions.
+// Shader functions are then called from several threads at once: they must
+// only read their context.
+#ifdef PASTEL_THREADS
+#include <pthread.h>
+
+// Max number of threads of a pool.
+#ifndef PASTEL_MAX_THREADS
+#define PASTEL_MAX_THREADS 64
+#endif
+
+// Size in bytes of the band of rows given to a thread at once.
+// It should fit in the L2 cache of a core.
+#ifndef PASTEL_THREAD_BAND_BYTES
+#define PASTEL_THREAD_BAND_BYTES (256 * 1024)
+#endif
+
+// A fixed set of worker threads, living in caller-provided storage.
+// A job is a function called once for every task index in [0, task_count).
+// The tasks are handed out one at a time to the workers and to the calling thread.
+typedef struct {
+  pthread_t threads[PASTEL_MAX_THREADS];
+  size_t thread_count;
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  void (*job)(size_t task, void* context);
+  void* job_context;
+  size_t task_count;
+  size_t next_task;
+  size_t tasks_done;
+  size_t generation;
+  bool quit;
+} PastelThreadPool;
+
+// @brief Start a pool of @param thread_count threads, counting the calling thread
+// (so `thread_count - 1` workers are created, at most PASTEL_MAX_THREADS - 1).
+// @return false if the threads could not be created.
+PASTELDEF bool pastel_thread_pool_init(PastelThreadPool* pool, size_t thread_count);
+
+// @brief Stop and join the worker threads of the pool.
+PASTELDEF void pastel_thread_pool_destroy(PastelThreadPool* pool);
+
+// @brief Run `job(task, context)` for every task in [0, task_count) on the pool
+// and wait for all of them to be done. The calling thread takes tasks too.
+PASTELDEF void pastel_thread_pool_run(PastelThreadPool* pool, void (*job)(size_t task, void* context), void* context, size_t task_count);
+
+// @brief Same as `pastel_fill` but the clip rectangle is split into bands of rows
+// filled in parallel by the threads of @param pool.
+// The pixels are the same as the ones of `pastel_fill`.
+PASTELDEF void pastel_fill_parallel(PastelThreadPool* pool, PastelCanvas* canvas, PastelShader shader);
+
+// @brief Same as `pastel_fill_blend`, in parallel like `pastel_fill_parallel`.
+PASTELDEF void pastel_fill_blend_parallel(PastelThreadPool* pool, PastelCanvas* canvas, PastelShader shader);
+#endif // PASTEL_THREADS
+
+// ----------------------------------------------
+// -------------- DEFERRED RENDERING ------------
+// ----------------------------------------------
+// Instead of drawing each primitive right away across the whole canvas,
+// primitives can be recorded in a command list and rendered later, tile by tile:
+// every tile of PASTEL_TILE_SIZE x PASTEL_TILE_SIZE pixels stays in the cache while
+// all the primitives covering it are drawn, in the order they were recorded.
+// The pixels are the same as the ones of the immediate functions.
+// Since shaders run at render time, their contexts must stay alive and unchanged
+// until the command list is rendered.
+
+// Side in pixels of the square tiles of the deferred renderer.
+#ifndef PASTEL_TILE_SIZE
+#define PASTEL_TILE_SIZE 64
+#endif
+
+typedef enum {
+  PASTEL_COMMAND_FILL,
+  PASTEL_COMMAND_FILL_BLEND,
+  PASTEL_COMMAND_FILL_RECT,
+  PASTEL_COMMAND_FILL_CIRCLE,
+  PASTEL_COMMAND_DRAW_LINE,
+  PASTEL_COMMAND_FILL_TRIANGLE,
+  PASTEL_COMMAND_FILL_TRIANGLE_SUBPIXEL,
+  PASTEL_COMMAND_FILL_TRIANGLE2_ORIENTED,
+  PASTEL_COMMAND_FILL_TRIANGLE2,
+} PastelCommandType;
+
+// A recorded primitive.
+typedef struct {
+  PastelCommandType type;
+  Vec2i p[3];
+  Vec2ui dim_rect;
+  size_t r;
+  PastelShader shader;
+  // Pixels the primitive can touch, inside the clip rectangle of the canvas when it was
+  // recorded: drawing is clipped to them.
+  PastelRect bounds;
+} PastelCommand;
+
+// A command list records primitives for a canvas, in caller-provided storage:
+//   - `commands`: the recorded primitives.
+//   - `bins`: scratch memory to sort the commands by tile. Binning needs
+//     (number of tiles + 1 + sum over commands of the number of tiles they cover) entries.
+//     If it is too small, every tile goes through the whole list instead.
+// When the list is full, it is rendered and cleared before recording the next primitive.
+// Multisample anti-aliasing (MSAA): each pixel of a tile holds 4 color samples.
+// Triangles cover the samples inside them (top-left rule on every sample) and the shader
+// runs once per pixel; the other primitives cover the 4 samples of their pixels.
+// Once all its commands are drawn, the tile is resolved: each pixel gets the mean of its samples.
+// Sample positions, in 1/16 of pixel from the center (rotated grid):
+// (-2, -6), (6, -2), (-6, 2), (2, 6).
+// Only a tile is stored at once, so a PastelMsaaTile (64 KiB for 64x64 tiles) is needed
+// per tile rendered in parallel, not a 4x canvas.
+struct PastelMsaaTile {
+  PastelRect rect; // pixels of the canvas held by the tile
+  // The 4 samples of pixel (x, y) start at ((y - rect.y0) * PASTEL_TILE_SIZE + x - rect.x0) * 4.
+  Color samples[4 * PASTEL_TILE_SIZE * PASTEL_TILE_SIZE];
+};
+
+typedef struct {
+  PastelCanvas* canvas;
+  PastelCommand* commands;
+  size_t commands_capacity;
+  size_t count;
+  uint32_t* bins;
+  size_t bins_capacity;
+  // Optional: multisample storage, see `pastel_command_list_set_msaa`.
+  PastelMsaaTile* msaa;
+  size_t msaa_count;
+#ifdef PASTEL_THREADS
+  // Optional: the tiles are rendered in parallel by the threads of the pool.
+  PastelThreadPool* pool;
+#endif
+} PastelCommandList;
+
+// @brief Create an empty command list drawing on @param canvas.
+PASTELDEF PastelCommandList pastel_command_list_create(PastelCanvas* canvas, PastelCommand* commands, size_t commands_capacity, uint32_t* bins, size_t bins_capacity);
+
+// @brief Render the recorded primitives on the canvas and clear the list.
+PASTELDEF void pastel_command_list_render(PastelCommandList* list);
+
+// @brief Render the list with 4x multisample anti-aliasing, in the @param tiles_count
+// caller-provided @param tiles: with a thread pool, up to `tiles_count` tiles are rendered
+// at once, otherwise only the first one is used. NULL goes back to the regular rendering.
+PASTELDEF void pastel_command_list_set_msaa(PastelCommandList* list, PastelMsaaTile* tiles, size_t tiles_count);
+
+// @brief Record a primitive: same parameters as the immediate function of the same name.
+// The current clip rectangle of the canvas is recorded with it.
+PASTELDEF void pastel_command_list_fill(PastelCommandList* list, PastelShader shader);
+PASTELDEF void pastel_command_list_fill_blend(PastelCommandList* list, PastelShader shader);
+PASTELDEF void pastel_command_list_fill_rect(PastelCommandList* list, const Vec2i* p, const Vec2ui* dim_rect, PastelShader shader);
+PASTELDEF void pastel_command_list_fill_circle(PastelCommandList* list, const Vec2i* p, size_t r, PastelShader shader);
+PASTELDEF void pastel_command_list_draw_line(PastelCommandList* list, const Vec2i* p1, const Vec2i* p2, PastelShader shader);
+PASTELDEF void pastel_command_list_fill_triangle(PastelCommandList* list, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader);
+PASTELDEF void pastel_command_list_fill_triangle_subpixel(PastelCommandList* list, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader);
+PASTELDEF void pastel_command_list_fill_triangle2_oriented(PastelCommandList* list, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader);
+PASTELDEF void pastel_command_list_fill_triangle2(PastelCommandList* list, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader);
+
 #endif // PASTEL_H_
 
 
@@ -194,16 +616,157 @@ PASTELDEF void pastel_fill_triangle2(PastelCanvas* canvas, const Vec2i* p1, cons
 // -----------------------------------------------------
 #ifdef PASTEL_IMPLEMENTATION
 
+#if defined(PASTEL_AVX2)
+#include <immintrin.h>
+#elif defined(PASTEL_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(PASTEL_WASM_SIMD)
+#include <wasm_simd128.h>
+#endif
+
 PASTELDEF PastelCanvas pastel_canvas_create(Color* pixels, size_t pixels_width, size_t pixels_height) {
+  return pastel_canvas_create_with_stride(pixels, pixels_width, pixels_height, pixels_width);
+}
+
+PASTELDEF PastelCanvas pastel_canvas_create_with_stride(Color* pixels, size_t pixels_width, size_t pixels_height, size_t stride) {
   PastelCanvas canvas = {
     .pixels = pixels,
     .width = pixels_width,
     .height = pixels_height,
-    .stride = pixels_width
+    .stride = stride,
+    .premultiplied = false,
+    .clip = { 0, 0, (int)pixels_width - 1, (int)pixels_height - 1 },
+    .clip_stack = { { 0, 0, 0, 0 } },
+    .clip_depth = 0,
+    .depth = NULL,
+    .depth_stride = 0,
+    .msaa = NULL,
+    .damage = { { 0, 0, 0, 0 } },
+    .damage_count = 0
   };
   return canvas;
 }
 
+PASTELDEF bool pastel_canvas_push_clip(PastelCanvas* canvas, const Vec2i* p, const Vec2ui* dim_rect) {
+  if (canvas->clip_depth >= PASTEL_CLIP_STACK_SIZE) return false;
+  canvas->clip_stack[canvas->clip_depth++] = canvas->clip;
+  PastelRect* clip = &canvas->clip;
+  PASTEL_MAX2(clip->x0, clip->x0, p->x);
+  PASTEL_MAX2(clip->y0, clip->y0, p->y);
+  PASTEL_MIN2(clip->x1, clip->x1, p->x + (int)dim_rect->x);
+  PASTEL_MIN2(clip->y1, clip->y1, p->y + (int)dim_rect->y);
+  return true;
+}
+
+PASTELDEF void pastel_canvas_pop_clip(PastelCanvas* canvas) {
+  if (canvas->clip_depth == 0) return;
+  canvas->clip = canvas->clip_stack[--canvas->clip_depth];
+}
+
+PASTELDEF int64_t __pastel_rect_area(const PastelRect* r) {
+  return (int64_t)(r->x1 - r->x0 + 1) * (int64_t)(r->y1 - r->y0 + 1);
+}
+
+PASTELDEF PastelRect __pastel_rect_union(const PastelRect* a, const PastelRect* b) {
+  PastelRect u;
+  PASTEL_MIN2(u.x0, a->x0, b->x0);
+  PASTEL_MIN2(u.y0, a->y0, b->y0);
+  PASTEL_MAX2(u.x1, a->x1, b->x1);
+  PASTEL_MAX2(u.y1, a->y1, b->y1);
+  return u;
+}
+
+PASTELDEF void pastel_canvas_add_damage(PastelCanvas* canvas, const PastelRect* rect) {
+  PastelRect r;
+  PASTEL_MAX2(r.x0, rect->x0, 0);
+  PASTEL_MAX2(r.y0, rect->y0, 0);
+  PASTEL_MIN2(r.x1, rect->x1, (int)canvas->width - 1);
+  PASTEL_MIN2(r.y1, rect->y1, (int)canvas->height - 1);
+  if (r.x0 > r.x1 || r.y0 > r.y1) return;
+  // Merge r with the rectangles it overlaps enough (or contains, or is contained in),
+  // again with the merged rectangle, until none is left.
+  for (;;) {
+    size_t merge = canvas->damage_count;
+    for (size_t i = 0; i < canvas->damage_count; ++i) {
+      PastelRect u = __pastel_rect_union(&r, &canvas->damage[i]);
+      if (__pastel_rect_area(&u) <= __pastel_rect_area(&r) + __pastel_rect_area(&canvas->damage[i])) {
+        merge = i;
+        break;
+      }
+    }
+    if (merge == canvas->damage_count && canvas->damage_count == PASTEL_DAMAGE_RECTS) {
+      // No room left: merge with the rectangle growing the least
+      int64_t best = 0;
+      for (size_t i = 0; i < canvas->damage_count; ++i) {
+        PastelRect u = __pastel_rect_union(&r, &canvas->damage[i]);
+        int64_t growth = __pastel_rect_area(&u) - __pastel_rect_area(&canvas->damage[i]);
+        if (i == 0 || growth < best) {
+          best = growth;
+          merge = i;
+        }
+      }
+    }
+    if (merge == canvas->damage_count) break;
+    r = __pastel_rect_union(&r, &canvas->damage[merge]);
+    canvas->damage[merge] = canvas->damage[--canvas->damage_count];
+  }
+  canvas->damage[canvas->damage_count++] = r;
+}
+
+PASTELDEF void pastel_canvas_clear_damage(PastelCanvas* canvas) {
+  canvas->damage_count = 0;
+}
+
+// Add the rectangle [x0, x1] x [y0, y1], clipped to the clip rectangle, to the damage.
+PASTELDEF void __pastel_canvas_damage(PastelCanvas* canvas, int x0, int y0, int x1, int y1) {
+  const PastelRect* clip = &canvas->clip;
+  PastelRect r;
+  PASTEL_MAX2(r.x0, x0, clip->x0);
+  PASTEL_MAX2(r.y0, y0, clip->y0);
+  PASTEL_MIN2(r.x1, x1, clip->x1);
+  PASTEL_MIN2(r.y1, y1, clip->y1);
+  pastel_canvas_add_damage(canvas, &r);
+}
+
+PASTELDEF void pastel_canvas_attach_depth(PastelCanvas* canvas, float* depth, size_t depth_stride) {
+  canvas->depth = depth;
+  canvas->depth_stride = depth_stride;
+}
+
+PASTELDEF void pastel_canvas_clear_depth(PastelCanvas* canvas, float z) {
+  if (canvas->depth == NULL) return;
+  for (size_t y = 0; y < canvas->height; ++y) {
+    float* row = &PASTEL_DEPTH(canvas, 0, y);
+    for (size_t x = 0; x < canvas->width; ++x) row[x] = z;
+  }
+}
+
+PASTELDEF PastelShader pastel_shader_create(Color (*run)(int x, int y, void*), void* context) {
+  PastelShader shader = {
+    .run = run,
+    .context = context,
+    .flags = 0,
+    .run_span = NULL
+  };
+  return shader;
+}
+
+PASTELDEF Color pastel_shader_run(PastelShader shader, int x, int y) {
+  if (shader.run) return shader.run(x, y, shader.context);
+  Color color;
+  shader.run_span(x, x, y, &color, shader.context);
+  return color;
+}
+
+PASTELDEF void pastel_shader_run_span(PastelShader shader, int x0, int x1, int y, Color* out) {
+  if (shader.run_span) {
+    shader.run_span(x0, x1, y, out, shader.context);
+    return;
+  }
+  for (int x = x0; x <= x1; ++x) out[x - x0] = shader.run(x, y, shader.context);
+}
+
 PASTELDEF void pastel_blend_colors(Color* c1, Color c2) {
   Color c1r = PASTEL_RED_CHANNEL(*c1);
   Color c2r = PASTEL_RED_CHANNEL(c2);
@@ -216,6 +779,11 @@ PASTELDEF void pastel_blend_colors(Color* c1, Color c2) {
 
   Color c1a = PASTEL_ALPHA_CHANNEL(*c1);
   Color c2a = PASTEL_ALPHA_CHANNEL(c2);
+  // Opaque upper layer replaces the lower one, transparent one leaves it untouched.
+  // Both give the same result as the formula below (which would divide by 0
+  // if both layers were transparent).
+  if (c2a == 0xFF) { *c1 = c2; return; }
+  if (c2a == 0) return;
   Color ca = c2a*255 + c1a*(255-c2a);
 
   c1r  = (c2r*c2a*255 + c1r*c1a*(255-c2a))/ca; if (c1r > 255) c1r = 255;
@@ -225,254 +793,2156 @@ PASTELDEF void pastel_blend_colors(Color* c1, Color c2) {
   *c1 = PASTEL_RGBA(c1r, c1g, c1b, c1a);
 }
 
-PASTELDEF void pastel_fill(PastelCanvas* canvas, PastelShader shader) {
-  for (int y = 0; y < (int)canvas->height; ++y) {
-    for (int x = 0; x < (int)canvas->width; ++x) {
-      Color color = shader.run(x, y, shader.context);
-      PASTEL_PIXEL(canvas, x, y) = color;
-    }
-  }
-} // function `void pastel_fill`
+// The SIMD kernels below compute the same formula as `pastel_blend_colors`,
+// one pixel per lane, in single precision floats.
+// All the intermediate values are integers < 2^24 so they are exact in a float,
+// and a truncated float division `num/ca` with num < 2^24 and ca < 2^16 always
+// gives the same result as the integer division.
+// Lanes where the upper layer is transparent keep the lower layer, like the scalar version.
+#if defined(PASTEL_SSE2)
+PASTELDEF void __pastel_blend4_sse2(Color* dst, const Color* src) {
+  __m128i s = _mm_loadu_si128((const __m128i*)src);
+  __m128i sa = _mm_srli_epi32(s, 24);
+  __m128i transparent = _mm_cmpeq_epi32(sa, _mm_setzero_si128());
+  __m128i opaque = _mm_cmpeq_epi32(sa, _mm_set1_epi32(0xFF));
+  if (_mm_movemask_epi8(transparent) == 0xFFFF) return;
+  if (_mm_movemask_epi8(opaque) == 0xFFFF) { _mm_storeu_si128((__m128i*)dst, s); return; }
 
-PASTELDEF void pastel_fill_blend(PastelCanvas* canvas, PastelShader shader) {
-  for (int y = 0; y < (int)canvas->height; ++y) {
-    for (int x = 0; x < (int)canvas->width; ++x) {
-      Color color = shader.run(x, y, shader.context);
-      pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y), color);
-    }
-  }
-} // function `void pastel_fill`
+  __m128i d = _mm_loadu_si128((const __m128i*)dst);
+  __m128i mask = _mm_set1_epi32(0xFF);
+  __m128 k255 = _mm_set1_ps(255.0f);
+  __m128 sa_f = _mm_cvtepi32_ps(sa);
+  __m128 da_f = _mm_cvtepi32_ps(_mm_srli_epi32(d, 24));
+  __m128 w2 = _mm_mul_ps(sa_f, k255);
+  __m128 w1 = _mm_mul_ps(da_f, _mm_sub_ps(k255, sa_f));
+  __m128 ca = _mm_add_ps(w2, w1);
 
-PASTELDEF void pastel_fill_rect(PastelCanvas* canvas, const Vec2i* p, const Vec2ui* dim_rect, PastelShader shader) {
-  // A pixel image is row-major
-  for (int y = p->y; y <= p->y + (int)dim_rect->y; ++y) {
-    if (0 <= y && y < (int)canvas->height) {
-      for (int x = p->x; x <= p->x + (int)dim_rect->x; ++x) {
-        if (0 <= x && x < (int)canvas->width) {
-          Color color = shader.run(x, y, shader.context);
-          pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y), color);
-        }
-      }
-    }
+  __m128i out = _mm_cvttps_epi32(_mm_div_ps(ca, k255));
+  out = _mm_slli_epi32(out, 24);
+  for (int shift = 0; shift < 24; shift += 8) {
+    __m128 sc = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(s, _mm_cvtsi32_si128(shift)), mask));
+    __m128 dc = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(d, _mm_cvtsi32_si128(shift)), mask));
+    __m128 num = _mm_add_ps(_mm_mul_ps(sc, w2), _mm_mul_ps(dc, w1));
+    __m128i c = _mm_cvttps_epi32(_mm_div_ps(num, ca));
+    out = _mm_or_si128(out, _mm_sll_epi32(c, _mm_cvtsi32_si128(shift)));
   }
+  out = _mm_or_si128(_mm_and_si128(transparent, d), _mm_andnot_si128(transparent, out));
+  _mm_storeu_si128((__m128i*)dst, out);
 }
+#endif // PASTEL_SSE2
 
-PASTELDEF void pastel_fill_circle(PastelCanvas* canvas, const Vec2i* p, size_t r, PastelShader shader) {
-  int x0_aabb = p->x - r;
-  int y0_aabb = p->y - r;
-  int r2 = (int)(r * r);
-  for (int y = y0_aabb; y <= y0_aabb + 2 * (int)r; ++y) {
-    if (0 <= y && y < (int)canvas->height) {
-      int dist_to_center_y2 = (y - p->y) * (y - p->y);
-      for (int x = x0_aabb; x <= x0_aabb + 2 * (int)r; ++x) {
-        if (0 <= x && x < (int)canvas->width) {
-          int dist_to_center_x2 = (x - p->x) * (x - p->x);
-          if ((dist_to_center_x2 + dist_to_center_y2) <= r2) {
-            Color color = shader.run(x, y, shader.context);
-            pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y), color);
-          }
-        }
-      }
-    }
+#if defined(PASTEL_AVX2)
+PASTELDEF void __pastel_blend8_avx2(Color* dst, const Color* src) {
+  __m256i s = _mm256_loadu_si256((const __m256i*)src);
+  __m256i sa = _mm256_srli_epi32(s, 24);
+  __m256i transparent = _mm256_cmpeq_epi32(sa, _mm256_setzero_si256());
+  __m256i opaque = _mm256_cmpeq_epi32(sa, _mm256_set1_epi32(0xFF));
+  if (_mm256_movemask_epi8(transparent) == -1) return;
+  if (_mm256_movemask_epi8(opaque) == -1) { _mm256_storeu_si256((__m256i*)dst, s); return; }
+
+  __m256i d = _mm256_loadu_si256((const __m256i*)dst);
+  __m256i mask = _mm256_set1_epi32(0xFF);
+  __m256 k255 = _mm256_set1_ps(255.0f);
+  __m256 sa_f = _mm256_cvtepi32_ps(sa);
+  __m256 da_f = _mm256_cvtepi32_ps(_mm256_srli_epi32(d, 24));
+  __m256 w2 = _mm256_mul_ps(sa_f, k255);
+  __m256 w1 = _mm256_mul_ps(da_f, _mm256_sub_ps(k255, sa_f));
+  __m256 ca = _mm256_add_ps(w2, w1);
+
+  __m256i out = _mm256_cvttps_epi32(_mm256_div_ps(ca, k255));
+  out = _mm256_slli_epi32(out, 24);
+  for (int shift = 0; shift < 24; shift += 8) {
+    __m256 sc = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(s, _mm_cvtsi32_si128(shift)), mask));
+    __m256 dc = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(d, _mm_cvtsi32_si128(shift)), mask));
+    __m256 num = _mm256_add_ps(_mm256_mul_ps(sc, w2), _mm256_mul_ps(dc, w1));
+    __m256i c = _mm256_cvttps_epi32(_mm256_div_ps(num, ca));
+    out = _mm256_or_si256(out, _mm256_sll_epi32(c, _mm_cvtsi32_si128(shift)));
   }
+  out = _mm256_blendv_epi8(out, d, transparent);
+  _mm256_storeu_si256((__m256i*)dst, out);
 }
+#endif // PASTEL_AVX2
 
-PASTELDEF void pastel_draw_line(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, PastelShader shader) {
-  int x0 = p1->x; int y0 = p1->y;
-  int x1 = p2->x; int y1 = p2->y;
-  if (x0 == x1) {
-    // Vertical line
-    if (0 <= x0 && x0 < (int)canvas->width) {
-      if (y0 > y1) PASTEL_SWAP(int, y0, y1);
-      for (int y = y0; y <= y1; ++y) {
-        if (0 <= y && y < (int)canvas->height) {
-          Color color = shader.run(x0, y, shader.context);
-          pastel_blend_colors(&PASTEL_PIXEL(canvas, x0, y), color);
-        }
-      }
-    }
-  } else if (y0 == y1) {
-    // Horizontal line
-    if (0 <= y0 && y0 < (int)canvas->height) {
-      if (x0 > x1) PASTEL_SWAP(int, x0, x1);
-      for (int x = x0; x <= x1; ++x) {
-        if (0 <= x && x < (int)canvas->width) {
-          Color color = shader.run(x, y0, shader.context);
-          pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y0), color);
-        }
-      }
-    }
-  } else {
-    if (x0 > x1) {
-      PASTEL_SWAP(int, x0, x1);
-      PASTEL_SWAP(int, y0, y1);
-    }
-    // So, there is an "issue" with using int.
-    // If we simply increment y by the float slope, since it can be < 1,
-    // the casting of the slope to int will resolve to 0 and we would
-    // never increment y.
-    // One solution is to truncate to nearest int, but this is costly for the CPU
-    // as it means branching.
-    // Solution which minimizes branching (best would be to benchmark tbh):
-    int dx = x1 - x0; // dx != 0 here
-    int dy = y1 - y0;
-    // float slope = ((float)dy) / ((float)dx);
-    for (int x = x0; x <= x1; ++x) {
-      if (0 <= x && x < (int)canvas->width) {
-        int ystart = y0 + ((x-x0)*dy)/dx;
-        int yend   = y0 + ((x+1-x0)*dy)/dx;
-        if (ystart > yend) PASTEL_SWAP(int, ystart, yend);
-        for(int y = ystart; y <= yend; ++y) {
-          if (0 <= y && y < (int)canvas->height) {
-            Color color = shader.run(x, y, shader.context);
-            pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y), color);
-          }
-        }
-      }
-    }
+#if defined(PASTEL_WASM_SIMD)
+PASTELDEF void __pastel_blend4_wasm(Color* dst, const Color* src) {
+  v128_t s = wasm_v128_load(src);
+  v128_t sa = wasm_u32x4_shr(s, 24);
+  v128_t transparent = wasm_i32x4_eq(sa, wasm_i32x4_splat(0));
+  v128_t opaque = wasm_i32x4_eq(sa, wasm_i32x4_splat(0xFF));
+  if (wasm_i32x4_all_true(transparent)) return;
+  if (wasm_i32x4_all_true(opaque)) { wasm_v128_store(dst, s); return; }
+
+  v128_t d = wasm_v128_load(dst);
+  v128_t mask = wasm_i32x4_splat(0xFF);
+  v128_t k255 = wasm_f32x4_splat(255.0f);
+  v128_t sa_f = wasm_f32x4_convert_i32x4(sa);
+  v128_t da_f = wasm_f32x4_convert_i32x4(wasm_u32x4_shr(d, 24));
+  v128_t w2 = wasm_f32x4_mul(sa_f, k255);
+  v128_t w1 = wasm_f32x4_mul(da_f, wasm_f32x4_sub(k255, sa_f));
+  v128_t ca = wasm_f32x4_add(w2, w1);
+
+  v128_t out = wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_div(ca, k255));
+  out = wasm_i32x4_shl(out, 24);
+  for (int shift = 0; shift < 24; shift += 8) {
+    v128_t sc = wasm_f32x4_convert_i32x4(wasm_v128_and(wasm_u32x4_shr(s, shift), mask));
+    v128_t dc = wasm_f32x4_convert_i32x4(wasm_v128_and(wasm_u32x4_shr(d, shift), mask));
+    v128_t num = wasm_f32x4_add(wasm_f32x4_mul(sc, w2), wasm_f32x4_mul(dc, w1));
+    v128_t c = wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_div(num, ca));
+    out = wasm_v128_or(out, wasm_i32x4_shl(c, shift));
   }
+  out = wasm_v128_bitselect(d, out, transparent);
+  wasm_v128_store(dst, out);
 }
+#endif // PASTEL_WASM_SIMD
 
-// Convention: the triangles are stored counter-clockwise.
-//
-//                  ^
-//                  | normal -n (because we are on an image
-//                  |            so y-axis points DOWN)
-//         P0 +-----------+ P2
-//           |         |
-//          |       |
-//         |     |
-//        |   |
-//       + |
-//       P1
-// The normals n point always outside the triangle, so the triangle goes as:
-// P2 - P0, P1 - P2 and P0 - P1
-PASTELDEF void pastel_fill_triangle2_oriented(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
-  int x0 = p1->x; int y0 = p1->y;
-  int x1 = p2->x; int y1 = p2->y;
-  int x2 = p3->x; int y2 = p3->y;
+PASTELDEF void pastel_blend_span(Color* dst, const Color* src, size_t n) {
+  size_t i = 0;
+#if defined(PASTEL_AVX2)
+  for (; i + 8 <= n; i += 8) __pastel_blend8_avx2(dst + i, src + i);
+#endif
+#if defined(PASTEL_SSE2)
+  for (; i + 4 <= n; i += 4) __pastel_blend4_sse2(dst + i, src + i);
+#elif defined(PASTEL_WASM_SIMD)
+  for (; i + 4 <= n; i += 4) __pastel_blend4_wasm(dst + i, src + i);
+#endif
+  for (; i < n; ++i) pastel_blend_colors(&dst[i], src[i]);
+}
 
-  int aabb_x0, aabb_y0, aabb_x1, aabb_y1;
-  PASTEL_MIN3(aabb_x0, x0, x1, x2);
-  PASTEL_MIN3(aabb_y0, y0, y1, y2);
-  PASTEL_MAX3(aabb_x1, x0, x1, x2);
-  PASTEL_MAX3(aabb_y1, y0, y1, y2);
+// Exact round(x/255) for 0 <= x <= 65535 - 255.
+#define PASTEL_DIV255(x) (((x) + 128 + (((x) + 128) >> 8)) >> 8)
 
-  for (int y = aabb_y0; y <= aabb_y1; ++y) {
-    if (0 <= y && y < (int)canvas->height) {
-      for (int x = aabb_x0; x <= aabb_x1; ++x) {
-        if (0 <= x && x < (int)canvas->width) {
-          //
-          // Test if pixel is in triangle
-          //
-          int d1, d2, d3; // Dist to hyperplanes
-          // WARNING: because we are on an image, x-axis points to right
-          // but y-axis points to DOWN!
-          // If vector (x, y) then right-hand normal is (-y, x)
-          //
-          // Compute d1:
-          d1 = (x - x0) * (y0 - y2) + (y - y0) * (x2 - x0);
-          if (d1 < 0) continue;
-          // Compute d2:
-          d2 = (x - x2) * (y2 - y1) + (y - y2) * (x1 - x2);
-          if (d2 < 0) continue;
-          // Compute d3:
-          d3 = (x - x1) * (y1 - y0) + (y - y1) * (x0 - x1);
-          if (d3 < 0) continue;
-          Color color = shader.run(x, y, shader.context);
-          pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y), color);
+PASTELDEF Color pastel_color_premultiply(Color c) {
+  Color a = PASTEL_ALPHA_CHANNEL(c);
+  Color r = PASTEL_DIV255(PASTEL_RED_CHANNEL(c)*a);
+  Color g = PASTEL_DIV255(PASTEL_GREEN_CHANNEL(c)*a);
+  Color b = PASTEL_DIV255(PASTEL_BLUE_CHANNEL(c)*a);
+  Color color = PASTEL_RGBA(r, g, b, a);
+  return color;
+}
 
-        }
-      }
-    }
+PASTELDEF Color pastel_color_unpremultiply(Color c) {
+  Color a = PASTEL_ALPHA_CHANNEL(c);
+  if (a == 0) return 0;
+  Color r = (PASTEL_RED_CHANNEL(c)*255 + a/2)/a;   if (r > 255) r = 255;
+  Color g = (PASTEL_GREEN_CHANNEL(c)*255 + a/2)/a; if (g > 255) g = 255;
+  Color b = (PASTEL_BLUE_CHANNEL(c)*255 + a/2)/a;  if (b > 255) b = 255;
+  Color color = PASTEL_RGBA(r, g, b, a);
+  return color;
+}
+
+PASTELDEF void pastel_blend_colors_premultiplied(Color* c1, Color c2) {
+  Color inv = 255 - PASTEL_ALPHA_CHANNEL(c2);
+  Color r = PASTEL_RED_CHANNEL(c2)   + PASTEL_DIV255(PASTEL_RED_CHANNEL(*c1)*inv);   if (r > 255) r = 255;
+  Color g = PASTEL_GREEN_CHANNEL(c2) + PASTEL_DIV255(PASTEL_GREEN_CHANNEL(*c1)*inv); if (g > 255) g = 255;
+  Color b = PASTEL_BLUE_CHANNEL(c2)  + PASTEL_DIV255(PASTEL_BLUE_CHANNEL(*c1)*inv);  if (b > 255) b = 255;
+  Color a = PASTEL_ALPHA_CHANNEL(c2) + PASTEL_DIV255(PASTEL_ALPHA_CHANNEL(*c1)*inv); if (a > 255) a = 255;
+  *c1 = PASTEL_RGBA(r, g, b, a);
+}
+
+// The premultiplied kernels work on 16 bits lanes, one lane per channel:
+// c*alpha + 128 fits in 16 bits and PASTEL_DIV255 is exact there.
+#if defined(PASTEL_SSE2)
+// Broadcast the alpha of each pixel to its 4 channels.
+#define __PASTEL_SSE2_ALPHA16(x) _mm_shufflehi_epi16(_mm_shufflelo_epi16((x), _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3))
+
+PASTELDEF __m128i __pastel_div255_epu16_sse2(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+PASTELDEF void __pastel_blend4_premultiplied_sse2(Color* dst, const Color* src) {
+  __m128i s = _mm_loadu_si128((const __m128i*)src);
+  __m128i d = _mm_loadu_si128((const __m128i*)dst);
+  __m128i zero = _mm_setzero_si128();
+  __m128i k255 = _mm_set1_epi16(255);
+  __m128i s_lo = _mm_unpacklo_epi8(s, zero), s_hi = _mm_unpackhi_epi8(s, zero);
+  __m128i d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero);
+  __m128i inv_lo = _mm_sub_epi16(k255, __PASTEL_SSE2_ALPHA16(s_lo));
+  __m128i inv_hi = _mm_sub_epi16(k255, __PASTEL_SSE2_ALPHA16(s_hi));
+  d_lo = __pastel_div255_epu16_sse2(_mm_mullo_epi16(d_lo, inv_lo));
+  d_hi = __pastel_div255_epu16_sse2(_mm_mullo_epi16(d_hi, inv_hi));
+  _mm_storeu_si128((__m128i*)dst, _mm_adds_epu8(s, _mm_packus_epi16(d_lo, d_hi)));
+}
+
+PASTELDEF void __pastel_premultiply4_sse2(Color* dst, const Color* src) {
+  __m128i s = _mm_loadu_si128((const __m128i*)src);
+  __m128i zero = _mm_setzero_si128();
+  __m128i s_lo = _mm_unpacklo_epi8(s, zero), s_hi = _mm_unpackhi_epi8(s, zero);
+  s_lo = __pastel_div255_epu16_sse2(_mm_mullo_epi16(s_lo, __PASTEL_SSE2_ALPHA16(s_lo)));
+  s_hi = __pastel_div255_epu16_sse2(_mm_mullo_epi16(s_hi, __PASTEL_SSE2_ALPHA16(s_hi)));
+  __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+  __m128i out = _mm_or_si128(_mm_andnot_si128(alpha_mask, _mm_packus_epi16(s_lo, s_hi)), _mm_and_si128(alpha_mask, s));
+  _mm_storeu_si128((__m128i*)dst, out);
+}
+
+// Unpremultiplying divides by alpha, done in floats like `__pastel_blend4_sse2`.
+PASTELDEF void __pastel_unpremultiply4_sse2(Color* dst, const Color* src) {
+  __m128i s = _mm_loadu_si128((const __m128i*)src);
+  __m128i mask = _mm_set1_epi32(0xFF);
+  __m128i a = _mm_srli_epi32(s, 24);
+  __m128 a_f = _mm_cvtepi32_ps(a);
+  __m128 half_a_f = _mm_cvtepi32_ps(_mm_srli_epi32(a, 1));
+  __m128 k255 = _mm_set1_ps(255.0f);
+  __m128i out = _mm_slli_epi32(a, 24);
+  for (int shift = 0; shift < 24; shift += 8) {
+    __m128 c = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(s, _mm_cvtsi32_si128(shift)), mask));
+    __m128 q = _mm_min_ps(_mm_div_ps(_mm_add_ps(_mm_mul_ps(c, k255), half_a_f), a_f), k255);
+    out = _mm_or_si128(out, _mm_sll_epi32(_mm_cvttps_epi32(q), _mm_cvtsi32_si128(shift)));
   }
+  out = _mm_andnot_si128(_mm_cmpeq_epi32(a, _mm_setzero_si128()), out);
+  _mm_storeu_si128((__m128i*)dst, out);
 }
+#endif // PASTEL_SSE2
 
-// Same as `pastel_fill_triangle_oriented` but the triangle does not
-// need to have an orientation.
-PASTELDEF void pastel_fill_triangle2(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
-  int x0 = p1->x; int y0 = p1->y;
-  int x1 = p2->x; int y1 = p2->y;
-  int x2 = p3->x; int y2 = p3->y;
+#if defined(PASTEL_AVX2)
+#define __PASTEL_AVX2_ALPHA16(x) _mm256_shufflehi_epi16(_mm256_shufflelo_epi16((x), _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3))
 
-  int aabb_x0, aabb_y0, aabb_x1, aabb_y1;
-  PASTEL_MIN3(aabb_x0, x0, x1, x2);
-  PASTEL_MIN3(aabb_y0, y0, y1, y2);
-  PASTEL_MAX3(aabb_x1, x0, x1, x2);
-  PASTEL_MAX3(aabb_y1, y0, y1, y2);
+PASTELDEF __m256i __pastel_div255_epu16_avx2(__m256i x) {
+  x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
 
-  for (int y = aabb_y0; y <= aabb_y1; ++y) {
-    if (0 <= y && y < (int)canvas->height) {
-      for (int x = aabb_x0; x <= aabb_x1; ++x) {
-        if (0 <= x && x < (int)canvas->width) {
-          //
-          // Test if pixel is in triangle
-          //
-          int d1, d2, d3; // Dist to hyperplanes
-          d1 = (x - x0) * (y0 - y2) + (y - y0) * (x2 - x0);
-          d2 = (x - x2) * (y2 - y1) + (y - y2) * (x1 - x2);
-          d3 = (x - x1) * (y1 - y0) + (y - y1) * (x0 - x1);
-
-          bool has_neg = (d1 < 0) || (d2 < 0) || (d3 < 0);
-          bool has_pos = (d1 > 0) || (d2 > 0) || (d3 > 0);
-          if (!(has_neg && has_pos)) {
-            Color color = shader.run(x, y, shader.context);
-            pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y), color);
-          }
-        }
-      }
-    }
+PASTELDEF void __pastel_blend8_premultiplied_avx2(Color* dst, const Color* src) {
+  __m256i s = _mm256_loadu_si256((const __m256i*)src);
+  __m256i d = _mm256_loadu_si256((const __m256i*)dst);
+  __m256i zero = _mm256_setzero_si256();
+  __m256i k255 = _mm256_set1_epi16(255);
+  __m256i s_lo = _mm256_unpacklo_epi8(s, zero), s_hi = _mm256_unpackhi_epi8(s, zero);
+  __m256i d_lo = _mm256_unpacklo_epi8(d, zero), d_hi = _mm256_unpackhi_epi8(d, zero);
+  __m256i inv_lo = _mm256_sub_epi16(k255, __PASTEL_AVX2_ALPHA16(s_lo));
+  __m256i inv_hi = _mm256_sub_epi16(k255, __PASTEL_AVX2_ALPHA16(s_hi));
+  d_lo = __pastel_div255_epu16_avx2(_mm256_mullo_epi16(d_lo, inv_lo));
+  d_hi = __pastel_div255_epu16_avx2(_mm256_mullo_epi16(d_hi, inv_hi));
+  _mm256_storeu_si256((__m256i*)dst, _mm256_adds_epu8(s, _mm256_packus_epi16(d_lo, d_hi)));
+}
+
+PASTELDEF void __pastel_premultiply8_avx2(Color* dst, const Color* src) {
+  __m256i s = _mm256_loadu_si256((const __m256i*)src);
+  __m256i zero = _mm256_setzero_si256();
+  __m256i s_lo = _mm256_unpacklo_epi8(s, zero), s_hi = _mm256_unpackhi_epi8(s, zero);
+  s_lo = __pastel_div255_epu16_avx2(_mm256_mullo_epi16(s_lo, __PASTEL_AVX2_ALPHA16(s_lo)));
+  s_hi = __pastel_div255_epu16_avx2(_mm256_mullo_epi16(s_hi, __PASTEL_AVX2_ALPHA16(s_hi)));
+  __m256i alpha_mask = _mm256_set1_epi32((int)0xFF000000);
+  __m256i out = _mm256_blendv_epi8(_mm256_packus_epi16(s_lo, s_hi), s, alpha_mask);
+  _mm256_storeu_si256((__m256i*)dst, out);
+}
+#endif // PASTEL_AVX2
+
+#if defined(PASTEL_WASM_SIMD)
+#define __PASTEL_WASM_ALPHA16(x) wasm_i16x8_shuffle((x), (x), 3, 3, 3, 3, 7, 7, 7, 7)
+
+PASTELDEF v128_t __pastel_div255_u16_wasm(v128_t x) {
+  x = wasm_i16x8_add(x, wasm_i16x8_splat(128));
+  return wasm_u16x8_shr(wasm_i16x8_add(x, wasm_u16x8_shr(x, 8)), 8);
+}
+
+PASTELDEF void __pastel_blend4_premultiplied_wasm(Color* dst, const Color* src) {
+  v128_t s = wasm_v128_load(src);
+  v128_t d = wasm_v128_load(dst);
+  v128_t k255 = wasm_i16x8_splat(255);
+  v128_t s_lo = wasm_u16x8_extend_low_u8x16(s), s_hi = wasm_u16x8_extend_high_u8x16(s);
+  v128_t d_lo = wasm_u16x8_extend_low_u8x16(d), d_hi = wasm_u16x8_extend_high_u8x16(d);
+  v128_t inv_lo = wasm_i16x8_sub(k255, __PASTEL_WASM_ALPHA16(s_lo));
+  v128_t inv_hi = wasm_i16x8_sub(k255, __PASTEL_WASM_ALPHA16(s_hi));
+  d_lo = __pastel_div255_u16_wasm(wasm_i16x8_mul(d_lo, inv_lo));
+  d_hi = __pastel_div255_u16_wasm(wasm_i16x8_mul(d_hi, inv_hi));
+  wasm_v128_store(dst, wasm_u8x16_add_sat(s, wasm_u8x16_narrow_i16x8(d_lo, d_hi)));
+}
+
+PASTELDEF void __pastel_premultiply4_wasm(Color* dst, const Color* src) {
+  v128_t s = wasm_v128_load(src);
+  v128_t s_lo = wasm_u16x8_extend_low_u8x16(s), s_hi = wasm_u16x8_extend_high_u8x16(s);
+  s_lo = __pastel_div255_u16_wasm(wasm_i16x8_mul(s_lo, __PASTEL_WASM_ALPHA16(s_lo)));
+  s_hi = __pastel_div255_u16_wasm(wasm_i16x8_mul(s_hi, __PASTEL_WASM_ALPHA16(s_hi)));
+  v128_t alpha_mask = wasm_i32x4_splat((int)0xFF000000);
+  wasm_v128_store(dst, wasm_v128_bitselect(s, wasm_u8x16_narrow_i16x8(s_lo, s_hi), alpha_mask));
+}
+
+PASTELDEF void __pastel_unpremultiply4_wasm(Color* dst, const Color* src) {
+  v128_t s = wasm_v128_load(src);
+  v128_t mask = wasm_i32x4_splat(0xFF);
+  v128_t a = wasm_u32x4_shr(s, 24);
+  v128_t a_f = wasm_f32x4_convert_i32x4(a);
+  v128_t half_a_f = wasm_f32x4_convert_i32x4(wasm_u32x4_shr(a, 1));
+  v128_t k255 = wasm_f32x4_splat(255.0f);
+  v128_t out = wasm_i32x4_shl(a, 24);
+  for (int shift = 0; shift < 24; shift += 8) {
+    v128_t c = wasm_f32x4_convert_i32x4(wasm_v128_and(wasm_u32x4_shr(s, shift), mask));
+    v128_t q = wasm_f32x4_min(wasm_f32x4_div(wasm_f32x4_add(wasm_f32x4_mul(c, k255), half_a_f), a_f), k255);
+    out = wasm_v128_or(out, wasm_i32x4_shl(wasm_i32x4_trunc_sat_f32x4(q), shift));
   }
+  out = wasm_v128_andnot(out, wasm_i32x4_eq(a, wasm_i32x4_splat(0)));
+  wasm_v128_store(dst, out);
 }
+#endif // PASTEL_WASM_SIMD
 
-PASTELDEF void pastel_fill_triangle(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
-  int x0 = p1->x; int y0 = p1->y;
-  int x1 = p2->x; int y1 = p2->y;
-  int x2 = p3->x; int y2 = p3->y;
-  if ((y0 == y1 && y0 == y2) || (x0 == x1 && x0 == x2)) return; // degenerate triangle
-
-  // Sort the vertices according to the y-axis
-  if (y0 > y1) { PASTEL_SWAP(int, x0, x1); PASTEL_SWAP(int, y0, y1); }
-  if (y1 > y2) { PASTEL_SWAP(int, x1, x2); PASTEL_SWAP(int, y1, y2); }
-  if (y0 > y1) { PASTEL_SWAP(int, x0, x1); PASTEL_SWAP(int, y0, y1); }
-
-  // Draw first half of the triangle
-  int dx1 = x1 - x0;
-  int dy1 = y1 - y0;
-  int dx2 = x2 - x0;
-  int dy2 = y2 - y0;
-  for (int y = y0; y <= y1; ++y) {
-    if (0 <= y && y < (int)canvas->height) {
-      int xl1 = dy1 != 0 ? x0 + ((y-y0)*dx1)/dy1 : x0;
-      int xl2 = dy2 != 0 ? x0 + ((y-y0)*dx2)/dy2 : x0;
-      if (xl1 > xl2) PASTEL_SWAP(int, xl1, xl2);
-      for (int x = xl1; x <= xl2; ++x) {
-        if (0 <= x && x < (int)canvas->width) {
-          Color color = shader.run(x, y, shader.context);
-          pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y), color);
-        }
-      }
+PASTELDEF void pastel_blend_span_premultiplied(Color* dst, const Color* src, size_t n) {
+  size_t i = 0;
+#if defined(PASTEL_AVX2)
+  for (; i + 8 <= n; i += 8) __pastel_blend8_premultiplied_avx2(dst + i, src + i);
+#endif
+#if defined(PASTEL_SSE2)
+  for (; i + 4 <= n; i += 4) __pastel_blend4_premultiplied_sse2(dst + i, src + i);
+#elif defined(PASTEL_WASM_SIMD)
+  for (; i + 4 <= n; i += 4) __pastel_blend4_premultiplied_wasm(dst + i, src + i);
+#endif
+  for (; i < n; ++i) pastel_blend_colors_premultiplied(&dst[i], src[i]);
+}
+
+PASTELDEF void pastel_premultiply_span(Color* dst, const Color* src, size_t n) {
+  size_t i = 0;
+#if defined(PASTEL_AVX2)
+  for (; i + 8 <= n; i += 8) __pastel_premultiply8_avx2(dst + i, src + i);
+#endif
+#if defined(PASTEL_SSE2)
+  for (; i + 4 <= n; i += 4) __pastel_premultiply4_sse2(dst + i, src + i);
+#elif defined(PASTEL_WASM_SIMD)
+  for (; i + 4 <= n; i += 4) __pastel_premultiply4_wasm(dst + i, src + i);
+#endif
+  for (; i < n; ++i) dst[i] = pastel_color_premultiply(src[i]);
+}
+
+PASTELDEF void pastel_unpremultiply_span(Color* dst, const Color* src, size_t n) {
+  size_t i = 0;
+#if defined(PASTEL_SSE2)
+  for (; i + 4 <= n; i += 4) __pastel_unpremultiply4_sse2(dst + i, src + i);
+#elif defined(PASTEL_WASM_SIMD)
+  for (; i + 4 <= n; i += 4) __pastel_unpremultiply4_wasm(dst + i, src + i);
+#endif
+  for (; i < n; ++i) dst[i] = pastel_color_unpremultiply(src[i]);
+}
+
+PASTELDEF void pastel_average4_span(Color* dst, const Color* src, size_t n) {
+  size_t i = 0;
+#if defined(PASTEL_SSE2)
+  // 2 colors at a time: widen the 8 source colors to 16 bits, add them pairwise
+  // then add the two halves, round and narrow back.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16(2);
+  for (; i + 2 <= n; i += 2) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(src + 4 * i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(src + 4 * i + 4));
+    __m128i sa = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero));
+    __m128i sb = _mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpackhi_epi8(b, zero));
+    __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(sa, sb), _mm_unpackhi_epi64(sa, sb));
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+    _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(sum, sum));
+  }
+#elif defined(PASTEL_WASM_SIMD)
+  const v128_t two = wasm_i16x8_splat(2);
+  for (; i + 2 <= n; i += 2) {
+    v128_t a = wasm_v128_load(src + 4 * i);
+    v128_t b = wasm_v128_load(src + 4 * i + 4);
+    v128_t sa = wasm_i16x8_add(wasm_u16x8_extend_low_u8x16(a), wasm_u16x8_extend_high_u8x16(a));
+    v128_t sb = wasm_i16x8_add(wasm_u16x8_extend_low_u8x16(b), wasm_u16x8_extend_high_u8x16(b));
+    v128_t sum = wasm_i16x8_add(wasm_i64x2_shuffle(sa, sb, 0, 2), wasm_i64x2_shuffle(sa, sb, 1, 3));
+    sum = wasm_u16x8_shr(wasm_i16x8_add(sum, two), 2);
+    wasm_v128_store64_lane(dst + i, wasm_u8x16_narrow_i16x8(sum, sum), 0);
+  }
+#endif
+  for (; i < n; ++i) {
+    const Color* s = src + 4 * i;
+    Color color = 0;
+    for (int c = 0; c < 32; c += 8) {
+      uint32_t sum = ((s[0] >> c) & 0xFF) + ((s[1] >> c) & 0xFF) + ((s[2] >> c) & 0xFF) + ((s[3] >> c) & 0xFF);
+      color |= ((sum + 2) >> 2) << c;
     }
+    dst[i] = color;
   }
+}
+
+PASTELDEF void pastel_canvas_premultiply(PastelCanvas* canvas) {
+  if (canvas->premultiplied) return;
+  for (size_t y = 0; y < canvas->height; ++y) {
+    Color* row = &PASTEL_PIXEL(canvas, 0, y);
+    pastel_premultiply_span(row, row, canvas->width);
+  }
+  canvas->premultiplied = true;
+}
+
+PASTELDEF void pastel_canvas_unpremultiply(PastelCanvas* canvas) {
+  if (!canvas->premultiplied) return;
+  for (size_t y = 0; y < canvas->height; ++y) {
+    Color* row = &PASTEL_PIXEL(canvas, 0, y);
+    pastel_unpremultiply_span(row, row, canvas->width);
+  }
+  canvas->premultiplied = false;
+}
+
+// Write `n` times the same color, with wide stores when available.
+PASTELDEF void __pastel_fill_color_span(Color* dst, Color color, size_t n) {
+  size_t i = 0;
+#if defined(PASTEL_AVX2)
+  __m256i c8 = _mm256_set1_epi32((int)color);
+  for (; i + 8 <= n; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), c8);
+#endif
+#if defined(PASTEL_SSE2)
+  __m128i c4 = _mm_set1_epi32((int)color);
+  for (; i + 4 <= n; i += 4) _mm_storeu_si128((__m128i*)(dst + i), c4);
+#elif defined(PASTEL_WASM_SIMD)
+  v128_t c4 = wasm_i32x4_splat((int)color);
+  for (; i + 4 <= n; i += 4) wasm_v128_store(dst + i, c4);
+#endif
+  for (; i < n; ++i) dst[i] = color;
+}
+
+// Bring the shaded colors of a span to the alpha format of the canvas.
+// Opaque colors are the same in both formats.
+PASTELDEF void __pastel_convert_shader_span(const PastelCanvas* canvas, PastelShader shader, Color* span, size_t n) {
+  if (shader.flags & PASTEL_SHADER_OPAQUE) return;
+  bool shader_premultiplied = (shader.flags & PASTEL_SHADER_PREMULTIPLIED) != 0;
+  if (canvas->premultiplied && !shader_premultiplied) pastel_premultiply_span(span, span, n);
+  if (!canvas->premultiplied && shader_premultiplied) pastel_unpremultiply_span(span, span, n);
+}
+
+// ------------------------------------------------------
+// Multisample tiles: the span emitters below draw on the 4 samples of each pixel
+// when the canvas has a multisample tile (see `pastel_command_list_set_msaa`).
+
+#define __PASTEL_MSAA_SAMPLES(tile, x, y) \
+  (&(tile)->samples[((size_t)((y) - (tile)->rect.y0) * PASTEL_TILE_SIZE + (size_t)((x) - (tile)->rect.x0)) * 4])
+
+// Blend `color` (in the canvas alpha format) on the samples of pixel (x, y) set in `mask`.
+PASTELDEF void __pastel_msaa_blend_samples(PastelCanvas* canvas, int x, int y, Color color, unsigned mask) {
+  Color* samples = __PASTEL_MSAA_SAMPLES(canvas->msaa, x, y);
+  for (int k = 0; k < 4; ++k) {
+    if ((mask & (1u << k)) == 0) continue;
+    if (canvas->premultiplied) {
+      pastel_blend_colors_premultiplied(&samples[k], color);
+    } else {
+      pastel_blend_colors(&samples[k], color);
+    }
+  }
+}
+
+// Blend (or with `replace`, write) the colors of the pixels [x0, x0 + n) of row y
+// on all their samples. The colors are repeated 4 times to go through the span kernels.
+PASTELDEF void __pastel_msaa_write_span(PastelCanvas* canvas, int x0, int y, const Color* colors, size_t n, bool replace) {
+  Color* samples = __PASTEL_MSAA_SAMPLES(canvas->msaa, x0, y);
+  if (replace) {
+    for (size_t i = 0; i < n; ++i) __pastel_fill_color_span(&samples[4 * i], colors[i], 4);
+    return;
+  }
+  Color span[PASTEL_SPAN_CHUNK];
+  const size_t chunk = PASTEL_SPAN_CHUNK / 4;
+  for (size_t i = 0; i < n; i += chunk) {
+    size_t m = n - i < chunk ? n - i : chunk;
+    for (size_t j = 0; j < m; ++j) __pastel_fill_color_span(&span[4 * j], colors[i + j], 4);
+    if (canvas->premultiplied) {
+      pastel_blend_span_premultiplied(&samples[4 * i], span, 4 * m);
+    } else {
+      pastel_blend_span(&samples[4 * i], span, 4 * m);
+    }
+  }
+}
+
+// Blend the same color (in the canvas alpha format) on the pixels [x0, x1] of row y.
+PASTELDEF void __pastel_blend_color_span(PastelCanvas* canvas, int x0, int x1, int y, Color color) {
+  if (x0 > x1) return;
+  if (canvas->msaa) {
+    Color* samples = __PASTEL_MSAA_SAMPLES(canvas->msaa, x0, y);
+    size_t n = 4 * (size_t)(x1 - x0 + 1);
+    if (PASTEL_ALPHA_CHANNEL(color) == 0xFF) {
+      __pastel_fill_color_span(samples, color, n);
+    } else {
+      for (int x = x0; x <= x1; ++x) __pastel_msaa_blend_samples(canvas, x, y, color, 0xF);
+    }
+    return;
+  }
+  Color* dst = &PASTEL_PIXEL(canvas, x0, y);
+  size_t n = (size_t)(x1 - x0 + 1);
+  if (PASTEL_ALPHA_CHANNEL(color) == 0xFF) {
+    __pastel_fill_color_span(dst, color, n);
+    return;
+  }
+  if (PASTEL_ALPHA_CHANNEL(color) == 0 && (!canvas->premultiplied || color == 0)) return;
+
+  Color span[PASTEL_SPAN_CHUNK];
+  size_t chunk = n < PASTEL_SPAN_CHUNK ? n : PASTEL_SPAN_CHUNK;
+  __pastel_fill_color_span(span, color, chunk);
+  for (size_t i = 0; i < n; i += chunk) {
+    size_t m = n - i < chunk ? n - i : chunk;
+    if (canvas->premultiplied) {
+      pastel_blend_span_premultiplied(dst + i, span, m);
+    } else {
+      pastel_blend_span(dst + i, span, m);
+    }
+  }
+}
+
+// Same as `__pastel_blend_shader_span` but replaces the pixels instead of blending.
+PASTELDEF void __pastel_fill_shader_span(PastelCanvas* canvas, int x0, int x1, int y, PastelShader shader) {
+  if (x0 > x1) return;
+  if (canvas->msaa) {
+    Color span[PASTEL_SPAN_CHUNK];
+    while (x0 <= x1) {
+      int n = x1 - x0 + 1;
+      if (n > PASTEL_SPAN_CHUNK) n = PASTEL_SPAN_CHUNK;
+      pastel_shader_run_span(shader, x0, x0 + n - 1, y, span);
+      __pastel_convert_shader_span(canvas, shader, span, (size_t)n);
+      __pastel_msaa_write_span(canvas, x0, y, span, (size_t)n, true);
+      x0 += n;
+    }
+    return;
+  }
+  Color* row = &PASTEL_PIXEL(canvas, 0, y);
+  if (shader.flags & PASTEL_SHADER_CONSTANT) {
+    Color color = pastel_shader_run(shader, x0, y);
+    __pastel_convert_shader_span(canvas, shader, &color, 1);
+    __pastel_fill_color_span(&row[x0], color, (size_t)(x1 - x0 + 1));
+    return;
+  }
+  pastel_shader_run_span(shader, x0, x1, y, &row[x0]);
+  __pastel_convert_shader_span(canvas, shader, &row[x0], (size_t)(x1 - x0 + 1));
+}
+
+// Shade the pixels [x0, x1] of row y and blend them onto the canvas, chunk by chunk.
+// The span must already be clipped to the clip rectangle of the canvas.
+PASTELDEF void __pastel_blend_shader_span(PastelCanvas* canvas, int x0, int x1, int y, PastelShader shader) {
+  if (shader.flags & PASTEL_SHADER_CONSTANT) {
+    if (x0 > x1) return;
+    Color color = pastel_shader_run(shader, x0, y);
+    __pastel_convert_shader_span(canvas, shader, &color, 1);
+    __pastel_blend_color_span(canvas, x0, x1, y, color);
+    return;
+  }
+  if (shader.flags & PASTEL_SHADER_OPAQUE) {
+    __pastel_fill_shader_span(canvas, x0, x1, y, shader);
+    return;
+  }
+
+  Color span[PASTEL_SPAN_CHUNK];
+  while (x0 <= x1) {
+    int n = x1 - x0 + 1;
+    if (n > PASTEL_SPAN_CHUNK) n = PASTEL_SPAN_CHUNK;
+    pastel_shader_run_span(shader, x0, x0 + n - 1, y, span);
+    __pastel_convert_shader_span(canvas, shader, span, (size_t)n);
+    if (canvas->msaa) {
+      __pastel_msaa_write_span(canvas, x0, y, span, (size_t)n, false);
+    } else if (canvas->premultiplied) {
+      pastel_blend_span_premultiplied(&PASTEL_PIXEL(canvas, x0, y), span, (size_t)n);
+    } else {
+      pastel_blend_span(&PASTEL_PIXEL(canvas, x0, y), span, (size_t)n);
+    }
+    x0 += n;
+  }
+}
+
+// Shade a single pixel and blend it onto the canvas.
+PASTELDEF void __pastel_blend_shader_pixel(PastelCanvas* canvas, int x, int y, PastelShader shader) {
+  Color color = pastel_shader_run(shader, x, y);
+  __pastel_convert_shader_span(canvas, shader, &color, 1);
+  if (canvas->msaa) {
+    __pastel_msaa_blend_samples(canvas, x, y, color, 0xF);
+  } else if (canvas->premultiplied) {
+    pastel_blend_colors_premultiplied(&PASTEL_PIXEL(canvas, x, y), color);
+  } else {
+    pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y), color);
+  }
+}
+
+PASTELDEF void pastel_fill(PastelCanvas* canvas, PastelShader shader) {
+  const PastelRect* clip = &canvas->clip;
+  __pastel_canvas_damage(canvas, clip->x0, clip->y0, clip->x1, clip->y1);
+  for (int y = clip->y0; y <= clip->y1; ++y) {
+    __pastel_fill_shader_span(canvas, clip->x0, clip->x1, y, shader);
+  }
+} // function `void pastel_fill`
+
+PASTELDEF void pastel_fill_blend(PastelCanvas* canvas, PastelShader shader) {
+  const PastelRect* clip = &canvas->clip;
+  __pastel_canvas_damage(canvas, clip->x0, clip->y0, clip->x1, clip->y1);
+  for (int y = clip->y0; y <= clip->y1; ++y) {
+    __pastel_blend_shader_span(canvas, clip->x0, clip->x1, y, shader);
+  }
+} // function `void pastel_fill`
+
+PASTELDEF void pastel_fill_rect(PastelCanvas* canvas, const Vec2i* p, const Vec2ui* dim_rect, PastelShader shader) {
+  // Clip the rectangle once, then blend it row by row
+  // (a pixel image is row-major).
+  const PastelRect* clip = &canvas->clip;
+  int x0, y0, x1, y1;
+  PASTEL_MAX2(x0, p->x, clip->x0);
+  PASTEL_MAX2(y0, p->y, clip->y0);
+  PASTEL_MIN2(x1, p->x + (int)dim_rect->x, clip->x1);
+  PASTEL_MIN2(y1, p->y + (int)dim_rect->y, clip->y1);
+  __pastel_canvas_damage(canvas, x0, y0, x1, y1);
+  for (int y = y0; y <= y1; ++y) {
+    __pastel_blend_shader_span(canvas, x0, x1, y, shader);
+  }
+}
+
+PASTELDEF void __pastel_fill_circle_rows(PastelCanvas* canvas, const Vec2i* p, size_t r, PastelShader shader);
+
+PASTELDEF void pastel_fill_circle(PastelCanvas* canvas, const Vec2i* p, size_t r, PastelShader shader) {
+  __pastel_canvas_damage(canvas, p->x - (int)r, p->y - (int)r, p->x + (int)r, p->y + (int)r);
+  __pastel_fill_circle_rows(canvas, p, r, shader);
+}
+
+// Rows of `pastel_fill_circle`, once its damage is added.
+PASTELDEF void __pastel_fill_circle_rows(PastelCanvas* canvas, const Vec2i* p, size_t r, PastelShader shader) {
+  const PastelRect* clip = &canvas->clip;
+  int r2 = (int)(r * r);
+  // The pixels of the rows p->y - dy and p->y + dy inside the circle form the span
+  // [p->x - dx, p->x + dx], with dx the largest integer such that dx^2 + dy^2 <= r^2.
+  // Going from the top row (dy = r) to the center row (dy = 0), dx only grows:
+  // it is stepped incrementally, so there are only O(r) steps for the whole circle.
+  int dx = 0;
+  int dx2_next = 1; // (dx + 1)^2
+  for (int dy = (int)r; dy >= 0; --dy) {
+    int dy2 = dy * dy;
+    while (dx2_next + dy2 <= r2) {
+      dx2_next += 2 * dx + 3;
+      ++dx;
+    }
+    int xl, xr;
+    PASTEL_MAX2(xl, p->x - dx, clip->x0);
+    PASTEL_MIN2(xr, p->x + dx, clip->x1);
+    int y = p->y - dy;
+    if (clip->y0 <= y && y <= clip->y1) __pastel_blend_shader_span(canvas, xl, xr, y, shader);
+    y = p->y + dy;
+    if (dy > 0 && clip->y0 <= y && y <= clip->y1) __pastel_blend_shader_span(canvas, xl, xr, y, shader);
+  }
+}
+
+// Shade the pixels [y0, y1] of column x and blend them onto the canvas.
+// The column must already be clipped to the clip rectangle of the canvas.
+PASTELDEF void __pastel_blend_shader_column(PastelCanvas* canvas, int x, int y0, int y1, PastelShader shader) {
+  if (shader.flags & PASTEL_SHADER_CONSTANT) {
+    if (y0 > y1) return;
+    Color color = pastel_shader_run(shader, x, y0);
+    __pastel_convert_shader_span(canvas, shader, &color, 1);
+    if (canvas->msaa) {
+      for (int y = y0; y <= y1; ++y) __pastel_blend_color_span(canvas, x, x, y, color);
+      return;
+    }
+    Color* pixel = &PASTEL_PIXEL(canvas, x, y0);
+    for (int y = y0; y <= y1; ++y, pixel += canvas->stride) {
+      if (canvas->premultiplied) {
+        pastel_blend_colors_premultiplied(pixel, color);
+      } else {
+        pastel_blend_colors(pixel, color);
+      }
+    }
+    return;
+  }
+  for (int y = y0; y <= y1; ++y) {
+    __pastel_blend_shader_pixel(canvas, x, y, shader);
+  }
+}
+
+// Pixels that `pastel_draw_line(p1, p2)` can touch.
+PASTELDEF PastelRect __pastel_line_bounds(const Vec2i* p1, const Vec2i* p2) {
+  int x0 = p1->x; int y0 = p1->y;
+  int x1 = p2->x; int y1 = p2->y;
+  if (x0 > x1) {
+    PASTEL_SWAP(int, x0, x1);
+    PASTEL_SWAP(int, y0, y1);
+  }
+  // `pastel_draw_line` also draws the pixels of the last column up to
+  // y0 + ((x1 + 1 - x0) * dy) / dx, which can go past y1.
+  int yend = y1;
+  if (x0 != x1 && y0 != y1) yend = y0 + ((x1 + 1 - x0) * (y1 - y0)) / (x1 - x0);
+  PastelRect bounds;
+  bounds.x0 = x0;
+  bounds.x1 = x1;
+  PASTEL_MIN3(bounds.y0, y0, y1, yend);
+  PASTEL_MAX3(bounds.y1, y0, y1, yend);
+  return bounds;
+}
+
+PASTELDEF void pastel_draw_line(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, PastelShader shader) {
+  const PastelRect* clip = &canvas->clip;
+  int x0 = p1->x; int y0 = p1->y;
+  int x1 = p2->x; int y1 = p2->y;
+  PastelRect bounds = __pastel_line_bounds(p1, p2);
+  __pastel_canvas_damage(canvas, bounds.x0, bounds.y0, bounds.x1, bounds.y1);
+  if (x0 == x1) {
+    // Vertical line
+    if (clip->x0 <= x0 && x0 <= clip->x1) {
+      if (y0 > y1) PASTEL_SWAP(int, y0, y1);
+      PASTEL_MAX2(y0, y0, clip->y0);
+      PASTEL_MIN2(y1, y1, clip->y1);
+      __pastel_blend_shader_column(canvas, x0, y0, y1, shader);
+    }
+  } else if (y0 == y1) {
+    // Horizontal line
+    if (clip->y0 <= y0 && y0 <= clip->y1) {
+      if (x0 > x1) PASTEL_SWAP(int, x0, x1);
+      PASTEL_MAX2(x0, x0, clip->x0);
+      PASTEL_MIN2(x1, x1, clip->x1);
+      __pastel_blend_shader_span(canvas, x0, x1, y0, shader);
+    }
+  } else {
+    if (x0 > x1) {
+      PASTEL_SWAP(int, x0, x1);
+      PASTEL_SWAP(int, y0, y1);
+    }
+    // Column x = x0 + k, k in [0, dx], covers the rows from y0 + sy * q(k) to y0 + sy * q(k + 1),
+    // with q(k) = floor(k * |dy| / dx).
+    // q is stepped with integers only (Bresenham-like): q(k + 1) = q(k) + inc, plus 1 when
+    // the remainder r of k * |dy| / dx goes past dx.
+    int dx = x1 - x0; // dx != 0 here
+    int dy = y1 - y0;
+    int sy = dy > 0 ? 1 : -1;
+    int ady = dy * sy;
+    int inc = ady / dx;
+    int rem = ady % dx;
+
+    // Clip the columns once
+    int kstart, kend;
+    PASTEL_MAX2(kstart, 0, clip->x0 - x0);
+    PASTEL_MIN2(kend, dx, clip->x1 - x0);
+    if (kstart > kend) return;
+    int64_t kq = (int64_t)kstart * ady;
+    int q = (int)(kq / dx);
+    int r = (int)(kq % dx);
+
+    if (ady < dx) {
+      // x-major: a row of pixels is a span of consecutive columns.
+      int span_k = kstart;
+      for (int k = kstart; k <= kend; ++k) {
+        r += rem;
+        if (r < dx) continue;
+        r -= dx;
+        // Column k covers rows q and q + 1: the span of row q ends here,
+        // the one of row q + 1 starts here.
+        int y = y0 + sy * q;
+        if (clip->y0 <= y && y <= clip->y1) {
+          __pastel_blend_shader_span(canvas, x0 + span_k, x0 + k, y, shader);
+        }
+        span_k = k;
+        q++;
+      }
+      int y = y0 + sy * q;
+      if (clip->y0 <= y && y <= clip->y1) {
+        __pastel_blend_shader_span(canvas, x0 + span_k, x0 + kend, y, shader);
+      }
+    } else {
+      // y-major: a column of pixels is a run of consecutive rows.
+      for (int k = kstart; k <= kend; ++k) {
+        int qn = q + inc;
+        r += rem;
+        if (r >= dx) {
+          r -= dx;
+          qn++;
+        }
+        int ystart = y0 + sy * q;
+        int yend = y0 + sy * qn;
+        if (ystart > yend) PASTEL_SWAP(int, ystart, yend);
+        PASTEL_MAX2(ystart, ystart, clip->y0);
+        PASTEL_MIN2(yend, yend, clip->y1);
+        __pastel_blend_shader_column(canvas, x0 + k, ystart, yend, shader);
+        q = qn;
+      }
+    }
+  }
+}
+
+// Side in pixels of the blocks of the AABB triangle rasterizers.
+#ifndef PASTEL_TRIANGLE_BLOCK_SIZE
+#define PASTEL_TRIANGLE_BLOCK_SIZE 8
+#endif
+// Max number of blocks classified at once in a row of blocks.
+#ifndef PASTEL_TRIANGLE_WINDOW_BLOCKS
+#define PASTEL_TRIANGLE_WINDOW_BLOCKS 64
+#endif
+
+// Edge function of a triangle: d(x, y) = d + (x - aabb_x0) * dx + (y - aabb_y0) * dy.
+// It is linear, so it can be stepped with additions only.
+typedef struct {
+  int d;
+  int dx;
+  int dy;
+} __PastelEdge;
+
+// Edge function of the oriented edge (xa, ya) -> (xb, yb), at the pixel (x, y).
+// WARNING: because we are on an image, x-axis points to right
+// but y-axis points to DOWN!
+// If vector (x, y) then right-hand normal is (-y, x)
+PASTELDEF __PastelEdge __pastel_edge(int xa, int ya, int xb, int yb, int x, int y) {
+  __PastelEdge edge = { (x - xa) * (ya - yb) + (y - ya) * (xb - xa), ya - yb, xb - xa };
+  return edge;
+}
+
+// Blend the pixels of the (clipped) aabb where the three edge functions are >= 0.
+// The aabb is cut in blocks of PASTEL_TRIANGLE_BLOCK_SIZE x PASTEL_TRIANGLE_BLOCK_SIZE pixels.
+// The edge functions are linear, so their extrema on a block are at its corners:
+//   - a block with its 4 corners outside of one of the edges is skipped.
+//   - a block with its 4 corners inside the 3 edges is blended without per-pixel tests.
+//   - the pixels of the other blocks are tested one by one, stepping the edge functions.
+// Consecutive blocks of the same kind are merged in runs, so each row of pixels
+// only goes through a few runs, and consecutive pixels inside the triangle are
+// blended as one span.
+PASTELDEF void __pastel_fill_triangle_edges(PastelCanvas* canvas, const __PastelEdge* edges,
+                                            int aabb_x0, int aabb_y0, int aabb_x1, int aabb_y1, PastelShader shader) {
+  enum { BLOCK_OUTSIDE, BLOCK_INSIDE, BLOCK_PARTIAL };
+  struct { int x0; int x1; int kind; } runs[PASTEL_TRIANGLE_WINDOW_BLOCKS];
+  const int B = PASTEL_TRIANGLE_BLOCK_SIZE;
+
+  for (int by = aabb_y0; by <= aabb_y1; by += B) {
+    int bh;
+    PASTEL_MIN2(bh, B, aabb_y1 - by + 1);
+    for (int wx = aabb_x0; wx <= aabb_x1; wx += B * PASTEL_TRIANGLE_WINDOW_BLOCKS) {
+      int wx1;
+      PASTEL_MIN2(wx1, wx + B * PASTEL_TRIANGLE_WINDOW_BLOCKS - 1, aabb_x1);
+
+      // Classify the blocks of the window, from the edge functions at their corners.
+      int runs_count = 0;
+      int corner[3]; // edge functions at the top left pixel of the block
+      for (int i = 0; i < 3; ++i) {
+        corner[i] = edges[i].d + (wx - aabb_x0) * edges[i].dx + (by - aabb_y0) * edges[i].dy;
+      }
+      for (int bx = wx; bx <= wx1; bx += B) {
+        int bw;
+        PASTEL_MIN2(bw, B, wx1 - bx + 1);
+        int kind = BLOCK_INSIDE;
+        for (int i = 0; i < 3; ++i) {
+          int c00 = corner[i];
+          int c10 = c00 + (bw - 1) * edges[i].dx;
+          int c01 = c00 + (bh - 1) * edges[i].dy;
+          int c11 = c10 + (bh - 1) * edges[i].dy;
+          corner[i] += B * edges[i].dx;
+          if (c00 < 0 && c10 < 0 && c01 < 0 && c11 < 0) {
+            kind = BLOCK_OUTSIDE;
+          } else if (kind == BLOCK_INSIDE && (c00 < 0 || c10 < 0 || c01 < 0 || c11 < 0)) {
+            kind = BLOCK_PARTIAL;
+          }
+        }
+        if (runs_count > 0 && runs[runs_count - 1].kind == kind) {
+          runs[runs_count - 1].x1 = bx + bw - 1;
+        } else {
+          runs[runs_count].x0 = bx;
+          runs[runs_count].x1 = bx + bw - 1;
+          runs[runs_count].kind = kind;
+          runs_count++;
+        }
+      }
 
-  // Draw second half of the triangle
-  dx1 = x2 - x0;
-  dy1 = y2 - y0;
-  dx2 = x2 - x1;
-  dy2 = y2 - y1;
-  for (int y = y1; y <= y2; ++y) {
-    if (0 <= y && y < (int)canvas->height) {
-      int xl1 = dy1 != 0 ? x2 + ((y-y2)*dx1)/dy1 : x2;
-      int xl2 = dy2 != 0 ? x2 + ((y-y2)*dx2)/dy2 : x2;
-      if (xl1 > xl2) PASTEL_SWAP(int, xl1, xl2);
-      for (int x = xl1; x <= xl2; ++x) {
-        if (0 <= x && x < (int)canvas->width) {
-          Color color = shader.run(x, y, shader.context);
-          pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y), color);
+      // Emit the spans of each row of the window.
+      for (int y = by; y < by + bh; ++y) {
+        int span_x0 = wx1 + 1;
+        for (int r = 0; r < runs_count; ++r) {
+          int x0 = runs[r].x0;
+          int x1 = runs[r].x1;
+          if (runs[r].kind == BLOCK_INSIDE) {
+            if (span_x0 > x0) span_x0 = x0;
+          } else if (runs[r].kind == BLOCK_OUTSIDE) {
+            if (span_x0 < x0) {
+              __pastel_blend_shader_span(canvas, span_x0, x0 - 1, y, shader);
+              span_x0 = wx1 + 1;
+            }
+          } else {
+            int d0 = edges[0].d + (x0 - aabb_x0) * edges[0].dx + (y - aabb_y0) * edges[0].dy;
+            int d1 = edges[1].d + (x0 - aabb_x0) * edges[1].dx + (y - aabb_y0) * edges[1].dy;
+            int d2 = edges[2].d + (x0 - aabb_x0) * edges[2].dx + (y - aabb_y0) * edges[2].dy;
+            for (int x = x0; x <= x1; ++x) {
+              bool inside = (d0 | d1 | d2) >= 0;
+              if (inside && span_x0 > x) span_x0 = x;
+              if (!inside && span_x0 < x) {
+                __pastel_blend_shader_span(canvas, span_x0, x - 1, y, shader);
+                span_x0 = wx1 + 1;
+              }
+              d0 += edges[0].dx; d1 += edges[1].dx; d2 += edges[2].dx;
+            }
+          }
         }
+        __pastel_blend_shader_span(canvas, span_x0, wx1, y, shader);
       }
     }
   }
 }
 
+// Convention: the triangles are stored counter-clockwise.
+//
+//                  ^
+//                  | normal -n (because we are on an image
+//                  |            so y-axis points DOWN)
+//         P0 +-----------+ P2
+//           |         |
+//          |       |
+//         |     |
+//        |   |
+//       + |
+//       P1
+// The normals n point always outside the triangle, so the triangle goes as:
+// P2 - P0, P1 - P2 and P0 - P1
+PASTELDEF void pastel_fill_triangle2_oriented(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
+  int x0 = p1->x; int y0 = p1->y;
+  int x1 = p2->x; int y1 = p2->y;
+  int x2 = p3->x; int y2 = p3->y;
+
+  int aabb_x0, aabb_y0, aabb_x1, aabb_y1;
+  PASTEL_MIN3(aabb_x0, x0, x1, x2);
+  PASTEL_MIN3(aabb_y0, y0, y1, y2);
+  PASTEL_MAX3(aabb_x1, x0, x1, x2);
+  PASTEL_MAX3(aabb_y1, y0, y1, y2);
+  __pastel_canvas_damage(canvas, aabb_x0, aabb_y0, aabb_x1, aabb_y1);
+
+  PASTEL_MAX2(aabb_x0, aabb_x0, canvas->clip.x0);
+  PASTEL_MAX2(aabb_y0, aabb_y0, canvas->clip.y0);
+  PASTEL_MIN2(aabb_x1, aabb_x1, canvas->clip.x1);
+  PASTEL_MIN2(aabb_y1, aabb_y1, canvas->clip.y1);
+
+  // A pixel is in the triangle if it is on the inner side of the 3 edges (Dist to hyperplanes >= 0).
+  __PastelEdge edges[3] = {
+    __pastel_edge(x0, y0, x2, y2, aabb_x0, aabb_y0),
+    __pastel_edge(x2, y2, x1, y1, aabb_x0, aabb_y0),
+    __pastel_edge(x1, y1, x0, y0, aabb_x0, aabb_y0),
+  };
+  __pastel_fill_triangle_edges(canvas, edges, aabb_x0, aabb_y0, aabb_x1, aabb_y1, shader);
+}
+
+PASTELDEF void pastel_fill_triangle2(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
+  int x0 = p1->x; int y0 = p1->y;
+  int x1 = p2->x; int y1 = p2->y;
+  int x2 = p3->x; int y2 = p3->y;
+
+  int aabb_x0, aabb_y0, aabb_x1, aabb_y1;
+  PASTEL_MIN3(aabb_x0, x0, x1, x2);
+  PASTEL_MIN3(aabb_y0, y0, y1, y2);
+  PASTEL_MAX3(aabb_x1, x0, x1, x2);
+  PASTEL_MAX3(aabb_y1, y0, y1, y2);
+  __pastel_canvas_damage(canvas, aabb_x0, aabb_y0, aabb_x1, aabb_y1);
+
+  PASTEL_MAX2(aabb_x0, aabb_x0, canvas->clip.x0);
+  PASTEL_MAX2(aabb_y0, aabb_y0, canvas->clip.y0);
+  PASTEL_MIN2(aabb_x1, aabb_x1, canvas->clip.x1);
+  PASTEL_MIN2(aabb_y1, aabb_y1, canvas->clip.y1);
+
+  __PastelEdge edges[3] = {
+    __pastel_edge(x0, y0, x2, y2, aabb_x0, aabb_y0),
+    __pastel_edge(x2, y2, x1, y1, aabb_x0, aabb_y0),
+    __pastel_edge(x1, y1, x0, y0, aabb_x0, aabb_y0),
+  };
+  // A pixel is in the triangle if the 3 distances have the same sign (or are 0).
+  // Their sum is twice the signed area of the triangle at every pixel, so
+  // for a clockwise triangle (negative area) they can only all be <= 0:
+  // flipping the edges brings us back to the counter-clockwise test.
+  // A flat triangle (zero area) only covers the pixels where the 3 distances are 0,
+  // for which both tests agree.
+  int area2 = (x1 - x0) * (y0 - y2) + (y1 - y0) * (x2 - x0);
+  if (area2 < 0) {
+    for (int i = 0; i < 3; ++i) {
+      edges[i].d = -edges[i].d;
+      edges[i].dx = -edges[i].dx;
+      edges[i].dy = -edges[i].dy;
+    }
+  }
+  __pastel_fill_triangle_edges(canvas, edges, aabb_x0, aabb_y0, aabb_x1, aabb_y1, shader);
+}
+
+// Round up a fixed-point number with `bits` fractional bits to an integer.
+PASTELDEF int __pastel_ceil_fixed(int64_t x, int bits) {
+  int64_t one = (int64_t)1 << bits;
+  return (int)(x >= 0 ? (x + one - 1) / one : -((-x) / one));
+}
+
+// Walk of a triangle edge (xa, ya) -> (xb, yb) (subpixel coordinates, ya < yb),
+// one pixel row at a time: `x` is the subpixel x of the edge at the current row,
+// with 16 more fractional bits, and `step` is added to it at each row.
+typedef struct {
+  int64_t x;
+  int64_t step;
+} __PastelEdgeWalk;
+
+// Start the walk of the edge (xa, ya) -> (xb, yb) at pixel row y.
+// The walk is always computed from the first row of the edge, so that two triangles
+// sharing an edge compute the same x at every row: the pixels of the shared edge then
+// go to exactly one of the triangles.
+PASTELDEF __PastelEdgeWalk __pastel_edge_walk(int xa, int ya, int xb, int yb, int y) {
+  const int S = PASTEL_SUBPIXEL_BITS;
+  int64_t dx = (int64_t)xb - xa;
+  int64_t dy = (int64_t)yb - ya;
+  int y_first = __pastel_ceil_fixed(ya, S);
+  int64_t rows_to_first = (int64_t)y_first * (1 << S) - ya;
+  __PastelEdgeWalk walk;
+  walk.step = dx * ((int64_t)1 << (16 + S)) / dy;
+  walk.x = (int64_t)xa * 65536 + rows_to_first * dx * 65536 / dy + (int64_t)(y - y_first) * walk.step;
+  return walk;
+}
+
+PASTELDEF void pastel_fill_triangle(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
+  const int S = PASTEL_SUBPIXEL_BITS;
+  Vec2i q1 = { p1->x * (1 << S), p1->y * (1 << S) };
+  Vec2i q2 = { p2->x * (1 << S), p2->y * (1 << S) };
+  Vec2i q3 = { p3->x * (1 << S), p3->y * (1 << S) };
+  pastel_fill_triangle_subpixel(canvas, &q1, &q2, &q3, shader);
+}
+
+// Depth test the pixels [x0, x1] of row y, whose depth starts at z and grows by dzdx
+// at each pixel, and draw the runs of visible pixels: hidden ones never reach the shader.
+PASTELDEF void __pastel_blend_shader_span_depth(PastelCanvas* canvas, int x0, int x1, int y, float z, float dzdx, PastelShader shader) {
+  float* depth = &PASTEL_DEPTH(canvas, 0, y);
+  int run_start = x0;
+  bool in_run = false;
+  for (int x = x0; x <= x1; ++x, z += dzdx) {
+    if (z < depth[x]) {
+      depth[x] = z;
+      if (!in_run) { run_start = x; in_run = true; }
+    } else if (in_run) {
+      __pastel_blend_shader_span(canvas, run_start, x - 1, y, shader);
+      in_run = false;
+    }
+  }
+  if (in_run) __pastel_blend_shader_span(canvas, run_start, x1, y, shader);
+}
+
+PASTELDEF void __pastel_fill_triangle_sorted(PastelCanvas* canvas, int x0, int y0, int x1, int y1, int x2, int y2,
+                                             bool middle_left, float w0, double dzdx, double dzdy,
+                                             bool depth_test, PastelShader shader);
+
+// Scanline rasterizer of `pastel_fill_triangle_subpixel`, and with `depth_test`,
+// of `pastel_fill_triangle_depth_subpixel`.
+PASTELDEF void __pastel_fill_triangle_spans(PastelCanvas* canvas,
+                                            const Vec2i* p1, float z1, const Vec2i* p2, float z2, const Vec2i* p3, float z3,
+                                            bool depth_test, PastelShader shader) {
+  const int S = PASTEL_SUBPIXEL_BITS;
+  int x0 = p1->x; int y0 = p1->y; float w0 = z1;
+  int x1 = p2->x; int y1 = p2->y; float w1 = z2;
+  int x2 = p3->x; int y2 = p3->y; float w2 = z3;
+
+  // Sort vertices by y
+  if (y0 > y1) { PASTEL_SWAP(int, x0, x1); PASTEL_SWAP(int, y0, y1); PASTEL_SWAP(float, w0, w1); }
+  if (y1 > y2) { PASTEL_SWAP(int, x1, x2); PASTEL_SWAP(int, y1, y2); PASTEL_SWAP(float, w1, w2); }
+  if (y0 > y1) { PASTEL_SWAP(int, x0, x1); PASTEL_SWAP(int, y0, y1); PASTEL_SWAP(float, w0, w1); }
+
+  // Which side of the long edge (x0, y0) -> (x2, y2) is the middle vertex on?
+  int64_t area2 = ((int64_t)x1 - x0) * ((int64_t)y2 - y0) - ((int64_t)y1 - y0) * ((int64_t)x2 - x0);
+  if (area2 == 0) return; // degenerate triangle
+  bool middle_left = area2 < 0;
+  int xmin, xmax;
+  PASTEL_MIN3(xmin, x0, x1, x2);
+  PASTEL_MAX3(xmax, x0, x1, x2);
+  __pastel_canvas_damage(canvas, __pastel_ceil_fixed(xmin, S), __pastel_ceil_fixed(y0, S),
+                         __pastel_ceil_fixed(xmax, S), __pastel_ceil_fixed(y2, S));
+
+  // Depth plane z(x, y) = w0 + dzdx * (x - x0) + dzdy * (y - y0), in pixels.
+  double dzdx = 0.0, dzdy = 0.0;
+  if (depth_test) {
+    double dx1 = x1 - x0, dy1 = y1 - y0, dz1 = w1 - w0;
+    double dx2 = x2 - x0, dy2 = y2 - y0, dz2 = w2 - w0;
+    dzdx = (dz1 * dy2 - dy1 * dz2) / (double)area2 * (1 << S);
+    dzdy = (dx1 * dz2 - dz1 * dx2) / (double)area2 * (1 << S);
+  }
+  __pastel_fill_triangle_sorted(canvas, x0, y0, x1, y1, x2, y2, middle_left, w0, dzdx, dzdy, depth_test, shader);
+}
+
+// Rows of a non-flat triangle whose subpixel vertices are sorted by y, once set up by
+// `__pastel_fill_triangle_spans` or by `pastel_fill_triangles`. `middle_left` tells if
+// (x1, y1) is left of the long edge (x0, y0) -> (x2, y2). With `depth_test`, the depth
+// plane starts at w0 on (x0, y0).
+PASTELDEF void __pastel_fill_triangle_sorted(PastelCanvas* canvas, int x0, int y0, int x1, int y1, int x2, int y2,
+                                             bool middle_left, float w0, double dzdx, double dzdy,
+                                             bool depth_test, PastelShader shader) {
+  const int S = PASTEL_SUBPIXEL_BITS;
+
+  // Pixel (x, y) is sampled at subpixel (x << S, y << S).
+  // Top-left rule: a pixel on a top or left edge is drawn, not on a bottom or right edge.
+  // So the rows [ceil(y0), ceil(y2) - 1] are drawn, and on each of them the pixels
+  // [ceil(x_left), ceil(x_right) - 1].
+  const PastelRect* clip = &canvas->clip;
+  int ystart, yend;
+
+  // Draw first half of the triangle, then the second one
+  for (int half = 0; half < 2; ++half) {
+    int ya = half == 0 ? y0 : y1;
+    int yb = half == 0 ? y1 : y2;
+    PASTEL_MAX2(ystart, __pastel_ceil_fixed(ya, S), clip->y0);
+    PASTEL_MIN2(yend, __pastel_ceil_fixed(yb, S) - 1, clip->y1);
+    if (ystart > yend) continue;
+    __PastelEdgeWalk long_edge = __pastel_edge_walk(x0, y0, x2, y2, ystart);
+    __PastelEdgeWalk short_edge = half == 0 ? __pastel_edge_walk(x0, y0, x1, y1, ystart)
+                                            : __pastel_edge_walk(x1, y1, x2, y2, ystart);
+    __PastelEdgeWalk* left = middle_left ? &short_edge : &long_edge;
+    __PastelEdgeWalk* right = middle_left ? &long_edge : &short_edge;
+    for (int y = ystart; y <= yend; ++y) {
+      int xl, xr;
+      PASTEL_MAX2(xl, __pastel_ceil_fixed(left->x, 16 + S), clip->x0);
+      PASTEL_MIN2(xr, __pastel_ceil_fixed(right->x, 16 + S) - 1, clip->x1);
+      if (depth_test) {
+        if (xl <= xr) {
+          double z = w0 + dzdx * (xl - (double)x0 / (1 << S)) + dzdy * (y - (double)y0 / (1 << S));
+          __pastel_blend_shader_span_depth(canvas, xl, xr, y, (float)z, (float)dzdx, shader);
+        }
+      } else {
+        __pastel_blend_shader_span(canvas, xl, xr, y, shader);
+      }
+      left->x += left->step;
+      right->x += right->step;
+    }
+  }
+}
+
+PASTELDEF void pastel_fill_triangle_subpixel(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
+  __pastel_fill_triangle_spans(canvas, p1, 0.0f, p2, 0.0f, p3, 0.0f, false, shader);
+}
+
+PASTELDEF void pastel_fill_triangle_depth(PastelCanvas* canvas, const Vec2i* p1, float z1, const Vec2i* p2, float z2, const Vec2i* p3, float z3, PastelShader shader) {
+  const int S = PASTEL_SUBPIXEL_BITS;
+  Vec2i q1 = { p1->x * (1 << S), p1->y * (1 << S) };
+  Vec2i q2 = { p2->x * (1 << S), p2->y * (1 << S) };
+  Vec2i q3 = { p3->x * (1 << S), p3->y * (1 << S) };
+  pastel_fill_triangle_depth_subpixel(canvas, &q1, z1, &q2, z2, &q3, z3, shader);
+}
+
+PASTELDEF void pastel_fill_triangle_depth_subpixel(PastelCanvas* canvas, const Vec2i* p1, float z1, const Vec2i* p2, float z2, const Vec2i* p3, float z3, PastelShader shader) {
+  __pastel_fill_triangle_spans(canvas, p1, z1, p2, z2, p3, z3, canvas->depth != NULL, shader);
+}
+
+// ------------------------------------------------------
+// Anti-aliasing: analytic coverage of the edge pixels.
+// pastel.h does not depend on libm, so the few functions needed are here.
+
+// `__builtin_sqrt` is only inlined when it does not have to set errno: elsewhere it
+// calls the `sqrt` of libm, so Newton's method is used instead.
+PASTELDEF double __pastel_sqrt(double x) {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__wasm__) || defined(__FAST_MATH__))
+  return __builtin_sqrt(x);
+#else
+  if (x <= 0.0) return 0.0;
+  double s = x > 1.0 ? x : 1.0;
+  for (int i = 0; i < 64; ++i) {
+    double next = 0.5 * (s + x / s);
+    if (next >= s) break;
+    s = next;
+  }
+  return s;
+#endif
+}
+
+PASTELDEF int __pastel_floor(double x) {
+  int i = (int)x;
+  return (double)i > x ? i - 1 : i;
+}
+
+PASTELDEF int __pastel_ceil(double x) {
+  int i = (int)x;
+  return (double)i < x ? i + 1 : i;
+}
+
+// asin(x) for x in [-1, 1]: series for |x| <= 1/2, and
+// asin(x) = pi/2 - 2 asin(sqrt((1 - x) / 2)) above.
+PASTELDEF double __pastel_asin(double x) {
+  double sign = x < 0.0 ? -1.0 : 1.0;
+  x *= sign;
+  bool reduced = x > 0.5;
+  if (reduced) x = __pastel_sqrt((1.0 - x) * 0.5);
+  // asin(x) = sum of (2n)! / (4^n (n!)^2 (2n + 1)) x^(2n + 1)
+  double x2 = x * x;
+  double term = x; // (2n)! / (4^n (n!)^2) x^(2n + 1)
+  double sum = x;
+  for (int n = 1; n < 24; ++n) {
+    term *= x2 * (2.0 * n - 1.0) / (2.0 * n);
+    sum += term / (2.0 * n + 1.0);
+  }
+  if (reduced) sum = 1.57079632679489661923 - 2.0 * sum;
+  return sign * sum;
+}
+
+// Coverage in [0, 255] of an area in [0, 1].
+PASTELDEF unsigned __pastel_coverage(double area) {
+  if (area <= 0.0) return 0;
+  if (area >= 1.0) return 255;
+  return (unsigned)(area * 255.0 + 0.5);
+}
+
+// Shade pixel (x, y) and blend it onto the canvas, with its alpha scaled by coverage / 255.
+PASTELDEF void __pastel_blend_shader_pixel_coverage(PastelCanvas* canvas, int x, int y, PastelShader shader, unsigned coverage) {
+  if (coverage == 0) return;
+  if (coverage >= 255) {
+    __pastel_blend_shader_pixel(canvas, x, y, shader);
+    return;
+  }
+  Color color = pastel_shader_run(shader, x, y);
+  __pastel_convert_shader_span(canvas, shader, &color, 1);
+  unsigned a = (PASTEL_ALPHA_CHANNEL(color) * coverage + 127) / 255;
+  if (canvas->premultiplied) {
+    // Every channel is scaled along with alpha
+    unsigned r = (PASTEL_RED_CHANNEL(color) * coverage + 127) / 255;
+    unsigned g = (PASTEL_GREEN_CHANNEL(color) * coverage + 127) / 255;
+    unsigned b = (PASTEL_BLUE_CHANNEL(color) * coverage + 127) / 255;
+    color = (a << 24) | (b << 16) | (g << 8) | r;
+  } else {
+    color = (a << 24) | (color & 0x00FFFFFF);
+  }
+  if (canvas->msaa) {
+    __pastel_msaa_blend_samples(canvas, x, y, color, 0xF);
+  } else if (canvas->premultiplied) {
+    pastel_blend_colors_premultiplied(&PASTEL_PIXEL(canvas, x, y), color);
+  } else {
+    pastel_blend_colors(&PASTEL_PIXEL(canvas, x, y), color);
+  }
+}
+
+PASTELDEF void pastel_draw_line_aa(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, PastelShader shader) {
+  const PastelRect* clip = &canvas->clip;
+  int x0 = p1->x; int y0 = p1->y;
+  int x1 = p2->x; int y1 = p2->y;
+  int adx = x1 > x0 ? x1 - x0 : x0 - x1;
+  int ady = y1 > y0 ? y1 - y0 : y0 - y1;
+  bool steep = ady > adx;
+  // Walk along the major axis u, the minor axis v is in 16.16 fixed-point.
+  int u0 = steep ? y0 : x0, v0 = steep ? x0 : y0;
+  int u1 = steep ? y1 : x1, v1 = steep ? x1 : y1;
+  if (u0 > u1) {
+    PASTEL_SWAP(int, u0, u1);
+    PASTEL_SWAP(int, v0, v1);
+  }
+  __pastel_canvas_damage(canvas, x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1, x0 > x1 ? x0 : x1, y0 > y1 ? y0 : y1);
+  int umin = steep ? clip->y0 : clip->x0, umax = steep ? clip->y1 : clip->x1;
+  int vmin = steep ? clip->x0 : clip->y0, vmax = steep ? clip->x1 : clip->y1;
+  int du = u1 - u0;
+  int64_t step = du == 0 ? 0 : (int64_t)(v1 - v0) * 65536 / du;
+
+  // Clip the major axis once
+  int ustart, uend;
+  PASTEL_MAX2(ustart, u0, umin);
+  PASTEL_MIN2(uend, u1, umax);
+  int64_t v = (int64_t)v0 * 65536 + (int64_t)(ustart - u0) * step;
+  for (int u = ustart; u <= uend; ++u, v += step) {
+    int vi = (int)(v >> 16);
+    unsigned frac = (unsigned)((v & 0xFFFF) >> 8); // in [0, 255]
+    // Pixel vi gets 1 - frac, pixel vi + 1 gets frac
+    if (vmin <= vi && vi <= vmax) {
+      if (steep) __pastel_blend_shader_pixel_coverage(canvas, vi, u, shader, 255 - frac);
+      else       __pastel_blend_shader_pixel_coverage(canvas, u, vi, shader, 255 - frac);
+    }
+    if (frac != 0 && vmin <= vi + 1 && vi + 1 <= vmax) {
+      if (steep) __pastel_blend_shader_pixel_coverage(canvas, vi + 1, u, shader, frac);
+      else       __pastel_blend_shader_pixel_coverage(canvas, u, vi + 1, shader, frac);
+    }
+  }
+}
+
+// Max number of vertices of a triangle clipped by a pixel square.
+#define __PASTEL_POLYGON_CAPACITY 8
+
+// Clip the convex polygon `in` (n points, x then y) to the half-plane
+// sign * coordinate <= sign * bound, `axis` being 0 for x and 1 for y.
+// @return the number of points written to `out`.
+PASTELDEF int __pastel_clip_polygon(const double* in, int n, double* out, int axis, double sign, double bound) {
+  int m = 0;
+  for (int i = 0; i < n; ++i) {
+    const double* a = &in[2 * i];
+    const double* b = &in[2 * ((i + 1) % n)];
+    double da = sign * (a[axis] - bound);
+    double db = sign * (b[axis] - bound);
+    if (da <= 0.0) {
+      out[2 * m] = a[0]; out[2 * m + 1] = a[1]; ++m;
+    }
+    if ((da < 0.0 && db > 0.0) || (da > 0.0 && db < 0.0)) {
+      double t = da / (da - db);
+      out[2 * m] = a[0] + t * (b[0] - a[0]);
+      out[2 * m + 1] = a[1] + t * (b[1] - a[1]);
+      out[2 * m + axis] = bound;
+      ++m;
+    }
+  }
+  return m;
+}
+
+// Area of a polygon of n points (shoelace formula).
+PASTELDEF double __pastel_polygon_area(const double* p, int n) {
+  double area2 = 0.0;
+  for (int i = 0; i < n; ++i) {
+    const double* a = &p[2 * i];
+    const double* b = &p[2 * ((i + 1) % n)];
+    area2 += a[0] * b[1] - b[0] * a[1];
+  }
+  return (area2 < 0.0 ? -area2 : area2) * 0.5;
+}
+
+// Extent [*xl, *xr] of the horizontal section at height y of the triangle `tri`
+// (3 points, x then y), for y between its lowest and highest vertices.
+PASTELDEF void __pastel_triangle_section(const double* tri, double y, double* xl, double* xr) {
+  *xl = 1e300; *xr = -1e300;
+  for (int i = 0; i < 3; ++i) {
+    const double* a = &tri[2 * i];
+    const double* b = &tri[2 * ((i + 1) % 3)];
+    if ((a[1] <= y && y <= b[1]) || (b[1] <= y && y <= a[1])) {
+      double x = a[1] == b[1] ? a[0] : a[0] + (y - a[1]) * (b[0] - a[0]) / (b[1] - a[1]);
+      if (x < *xl) *xl = x;
+      if (x > *xr) *xr = x;
+      if (a[1] == b[1]) {
+        if (b[0] < *xl) *xl = b[0];
+        if (b[0] > *xr) *xr = b[0];
+      }
+    }
+  }
+}
+
+PASTELDEF void pastel_fill_triangle_aa(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
+  const PastelRect* clip = &canvas->clip;
+  double tri[6] = { (double)p1->x, (double)p1->y, (double)p2->x, (double)p2->y, (double)p3->x, (double)p3->y };
+  int64_t area2 = ((int64_t)p2->x - p1->x) * ((int64_t)p3->y - p1->y) - ((int64_t)p2->y - p1->y) * ((int64_t)p3->x - p1->x);
+  if (area2 == 0) return; // degenerate triangle
+  int tymin, tymax, txmin, txmax;
+  PASTEL_MIN3(tymin, p1->y, p2->y, p3->y);
+  PASTEL_MAX3(tymax, p1->y, p2->y, p3->y);
+  PASTEL_MIN3(txmin, p1->x, p2->x, p3->x);
+  PASTEL_MAX3(txmax, p1->x, p2->x, p3->x);
+  __pastel_canvas_damage(canvas, txmin, tymin, txmax, tymax);
+
+  // Rows whose square [y - 0.5, y + 0.5] meets the triangle
+  int ystart, yend;
+  PASTEL_MAX2(ystart, tymin, clip->y0);
+  PASTEL_MIN2(yend, tymax, clip->y1);
+  for (int y = ystart; y <= yend; ++y) {
+    double yt = y - 0.5, yb = y + 0.5;
+    // The part of the triangle in the row
+    double band_top[2 * __PASTEL_POLYGON_CAPACITY], band[2 * __PASTEL_POLYGON_CAPACITY];
+    int n = __pastel_clip_polygon(tri, 3, band_top, 1, -1.0, yt);
+    n = __pastel_clip_polygon(band_top, n, band, 1, 1.0, yb);
+    if (n < 3) continue;
+    double bxmin = band[0], bxmax = band[0];
+    for (int i = 1; i < n; ++i) {
+      if (band[2 * i] < bxmin) bxmin = band[2 * i];
+      if (band[2 * i] > bxmax) bxmax = band[2 * i];
+    }
+    // Pixels [xf0, xf1] are inside the triangle: the row spans the whole square and
+    // the sections at its top and bottom contain it (the section extents are convex).
+    int xf0 = 1, xf1 = 0;
+    if (tymin <= yt && yb <= tymax) {
+      double lt, rt, lb, rb;
+      __pastel_triangle_section(tri, yt, &lt, &rt);
+      __pastel_triangle_section(tri, yb, &lb, &rb);
+      xf0 = __pastel_ceil((lt > lb ? lt : lb) + 0.5);
+      xf1 = __pastel_floor((rt < rb ? rt : rb) - 0.5);
+    }
+    // Pixels [xp0, xp1] meet the triangle
+    int xp0, xp1;
+    PASTEL_MAX2(xp0, __pastel_floor(bxmin - 0.5) + 1, clip->x0);
+    PASTEL_MIN2(xp1, __pastel_ceil(bxmax + 0.5) - 1, clip->x1);
+    if (xf0 > xf1) { xf0 = xp1 + 1; xf1 = xp1; }
+    PASTEL_MAX2(xf0, xf0, xp0);
+    PASTEL_MIN2(xf1, xf1, xp1);
+    for (int x = xp0; x <= xp1; ++x) {
+      if (x == xf0 && xf0 <= xf1) {
+        __pastel_blend_shader_span(canvas, xf0, xf1, y, shader);
+        x = xf1;
+        continue;
+      }
+      double left[2 * __PASTEL_POLYGON_CAPACITY], pixel[2 * __PASTEL_POLYGON_CAPACITY];
+      int m = __pastel_clip_polygon(band, n, left, 0, -1.0, x - 0.5);
+      m = __pastel_clip_polygon(left, m, pixel, 0, 1.0, x + 0.5);
+      if (m < 3) continue;
+      __pastel_blend_shader_pixel_coverage(canvas, x, y, shader, __pastel_coverage(__pastel_polygon_area(pixel, m)));
+    }
+  }
+}
+
+// Integral of sqrt(r^2 - t^2) from 0 to t, for t in [-r, r].
+PASTELDEF double __pastel_disk_integral(double r, double t) {
+  double u = t / r;
+  if (u > 1.0) u = 1.0;
+  if (u < -1.0) u = -1.0;
+  return 0.5 * (t * __pastel_sqrt(r * r - t * t > 0.0 ? r * r - t * t : 0.0) + r * r * __pastel_asin(u));
+}
+
+// Area of the intersection of the disk of radius r centered on (0, 0) and the square
+// [x0, x1] x [y0, y1]. The height of the intersection is a function of x made of
+// constants and of +/- sqrt(r^2 - x^2), which only changes where the circle meets y = y0 or y = y1.
+PASTELDEF double __pastel_disk_square_area(double r, double x0, double x1, double y0, double y1) {
+  if (x0 < -r) x0 = -r;
+  if (x1 > r) x1 = r;
+  if (x0 >= x1) return 0.0;
+  double t[6];
+  int n = 0;
+  t[n++] = x0;
+  double ys[2] = { y0, y1 };
+  for (int i = 0; i < 2; ++i) {
+    if (ys[i] <= -r || ys[i] >= r) continue;
+    double c = __pastel_sqrt(r * r - ys[i] * ys[i]);
+    if (x0 < -c && -c < x1) t[n++] = -c;
+    if (x0 < c && c < x1) t[n++] = c;
+  }
+  t[n++] = x1;
+  // Insertion sort of the breaks
+  for (int i = 1; i < n; ++i) {
+    for (int j = i; j > 0 && t[j - 1] > t[j]; --j) PASTEL_SWAP(double, t[j - 1], t[j]);
+  }
+  double area = 0.0;
+  for (int i = 0; i + 1 < n; ++i) {
+    double a = t[i], b = t[i + 1];
+    if (b <= a) continue;
+    double m = 0.5 * (a + b);
+    double s = __pastel_sqrt(r * r - m * m);
+    double upper = y1 < s ? y1 : s;
+    double lower = y0 > -s ? y0 : -s;
+    if (upper <= lower) continue;
+    double circle = __pastel_disk_integral(r, b) - __pastel_disk_integral(r, a);
+    area += (y1 < s ? y1 * (b - a) : circle) - (y0 > -s ? y0 * (b - a) : -circle);
+  }
+  return area;
+}
+
+PASTELDEF void pastel_fill_circle_aa(PastelCanvas* canvas, const Vec2i* p, size_t r, PastelShader shader) {
+  const PastelRect* clip = &canvas->clip;
+  if (r == 0) return;
+  double rd = (double)r;
+  int ir = (int)r;
+  __pastel_canvas_damage(canvas, p->x - ir, p->y - ir, p->x + ir, p->y + ir);
+  int ystart, yend;
+  PASTEL_MAX2(ystart, p->y - ir, clip->y0);
+  PASTEL_MIN2(yend, p->y + ir, clip->y1);
+  for (int y = ystart; y <= yend; ++y) {
+    int dy = y - p->y;
+    double ady = dy < 0 ? -dy : dy;
+    // Half-widths of the disk at the rows of the square nearest and farthest from the center
+    double near = ady > 0.5 ? ady - 0.5 : 0.0;
+    double far = ady + 0.5;
+    if (near >= rd) continue;
+    double half_max = __pastel_sqrt(rd * rd - near * near);
+    double half_min = far < rd ? __pastel_sqrt(rd * rd - far * far) : 0.0;
+    // Columns p->x +/- [0, kfull] are inside the disk, p->x +/- [0, kmax] meet it
+    int kfull = far < rd ? __pastel_floor(half_min - 0.5) : -1;
+    int kmax = __pastel_ceil(half_max + 0.5) - 1;
+    int xl, xr;
+    PASTEL_MAX2(xl, p->x - kfull, clip->x0);
+    PASTEL_MIN2(xr, p->x + kfull, clip->x1);
+    __pastel_blend_shader_span(canvas, xl, xr, y, shader);
+    for (int k = kfull + 1; k <= kmax; ++k) {
+      // Same coverage for p->x - k and p->x + k
+      double area = __pastel_disk_square_area(rd, k - 0.5, k + 0.5, dy - 0.5, dy + 0.5);
+      unsigned coverage = __pastel_coverage(area);
+      if (coverage == 0) continue;
+      int x = p->x - k;
+      if (clip->x0 <= x && x <= clip->x1) __pastel_blend_shader_pixel_coverage(canvas, x, y, shader, coverage);
+      x = p->x + k;
+      if (k > 0 && clip->x0 <= x && x <= clip->x1) __pastel_blend_shader_pixel_coverage(canvas, x, y, shader, coverage);
+    }
+  }
+}
+
+// Shader of the primitives of a batch: the color pointed to by the context.
+PASTELDEF Color __pastel_shader_func_batch_color(int x, int y, void* context) {
+  PASTEL_UNUSED(x);
+  PASTEL_UNUSED(y);
+  return *(const Color*)context;
+}
+
+PASTELDEF void pastel_fill_rects(PastelCanvas* canvas, const PastelRectBatch* batch) {
+  const PastelRect* clip = &canvas->clip;
+  int x0[PASTEL_BATCH_CHUNK], y0[PASTEL_BATCH_CHUNK], x1[PASTEL_BATCH_CHUNK], y1[PASTEL_BATCH_CHUNK];
+  for (size_t start = 0; start < batch->count; start += PASTEL_BATCH_CHUNK) {
+    size_t n = batch->count - start < PASTEL_BATCH_CHUNK ? batch->count - start : PASTEL_BATCH_CHUNK;
+    const int* x = batch->x + start;
+    const int* y = batch->y + start;
+    const int* w = batch->w + start;
+    const int* h = batch->h + start;
+    // Clip the rectangles of the chunk
+    for (size_t i = 0; i < n; ++i) {
+      int rx1 = x[i] + w[i];
+      int ry1 = y[i] + h[i];
+      x0[i] = x[i] > clip->x0 ? x[i] : clip->x0;
+      y0[i] = y[i] > clip->y0 ? y[i] : clip->y0;
+      x1[i] = rx1 < clip->x1 ? rx1 : clip->x1;
+      y1[i] = ry1 < clip->y1 ? ry1 : clip->y1;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      if (x0[i] > x1[i] || y0[i] > y1[i]) continue;
+      __pastel_canvas_damage(canvas, x0[i], y0[i], x1[i], y1[i]);
+      Color color = batch->colors[start + i];
+      if (canvas->premultiplied) color = pastel_color_premultiply(color);
+      for (int row = y0[i]; row <= y1[i]; ++row) {
+        __pastel_blend_color_span(canvas, x0[i], x1[i], row, color);
+      }
+    }
+  }
+}
+
+PASTELDEF void pastel_fill_circles(PastelCanvas* canvas, const PastelCircleBatch* batch) {
+  const PastelRect* clip = &canvas->clip;
+  bool visible[PASTEL_BATCH_CHUNK];
+  int x0[PASTEL_BATCH_CHUNK], y0[PASTEL_BATCH_CHUNK], x1[PASTEL_BATCH_CHUNK], y1[PASTEL_BATCH_CHUNK];
+  PastelShader shader = pastel_shader_create(__pastel_shader_func_batch_color, NULL);
+  shader.flags = PASTEL_SHADER_CONSTANT;
+  for (size_t start = 0; start < batch->count; start += PASTEL_BATCH_CHUNK) {
+    size_t n = batch->count - start < PASTEL_BATCH_CHUNK ? batch->count - start : PASTEL_BATCH_CHUNK;
+    const int* x = batch->x + start;
+    const int* y = batch->y + start;
+    const int* r = batch->r + start;
+    // Aabb (the damage) of the circles of the chunk, culled if outside of the clip rectangle
+    for (size_t i = 0; i < n; ++i) {
+      x0[i] = x[i] - r[i]; y0[i] = y[i] - r[i];
+      x1[i] = x[i] + r[i]; y1[i] = y[i] + r[i];
+      visible[i] = (x1[i] >= clip->x0) & (x0[i] <= clip->x1)
+                 & (y1[i] >= clip->y0) & (y0[i] <= clip->y1) & (r[i] >= 0);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      if (!visible[i]) continue;
+      Vec2i p = { x[i], y[i] };
+      shader.context = (void*)&batch->colors[start + i];
+      __pastel_canvas_damage(canvas, x0[i], y0[i], x1[i], y1[i]);
+      __pastel_fill_circle_rows(canvas, &p, (size_t)r[i], shader);
+    }
+  }
+}
+
+PASTELDEF void pastel_fill_triangles(PastelCanvas* canvas, const PastelTriangleBatch* batch) {
+  const int S = PASTEL_SUBPIXEL_BITS;
+  const PastelRect* clip = &canvas->clip;
+  bool visible[PASTEL_BATCH_CHUNK], middle_left[PASTEL_BATCH_CHUNK];
+  // Subpixel vertices sorted by y, and aabb (the damage) in pixels
+  int sx0[PASTEL_BATCH_CHUNK], sy0[PASTEL_BATCH_CHUNK], sx1[PASTEL_BATCH_CHUNK], sy1[PASTEL_BATCH_CHUNK];
+  int sx2[PASTEL_BATCH_CHUNK], sy2[PASTEL_BATCH_CHUNK];
+  int xmin[PASTEL_BATCH_CHUNK], ymin[PASTEL_BATCH_CHUNK], xmax[PASTEL_BATCH_CHUNK], ymax[PASTEL_BATCH_CHUNK];
+  PastelShader shader = pastel_shader_create(__pastel_shader_func_batch_color, NULL);
+  shader.flags = PASTEL_SHADER_CONSTANT;
+  for (size_t start = 0; start < batch->count; start += PASTEL_BATCH_CHUNK) {
+    size_t n = batch->count - start < PASTEL_BATCH_CHUNK ? batch->count - start : PASTEL_BATCH_CHUNK;
+    const int* x0 = batch->x0 + start; const int* y0 = batch->y0 + start;
+    const int* x1 = batch->x1 + start; const int* y1 = batch->y1 + start;
+    const int* x2 = batch->x2 + start; const int* y2 = batch->y2 + start;
+    // Set up the triangles of the chunk as `__pastel_fill_triangle_spans` does: the same
+    // sorting network by y (with selects), the side of the middle vertex, and the aabb.
+    // Flat triangles and the ones whose aabb is outside of the clip rectangle are culled.
+    for (size_t i = 0; i < n; ++i) {
+      int ax = x0[i] * (1 << S), ay = y0[i] * (1 << S);
+      int bx = x1[i] * (1 << S), by = y1[i] * (1 << S);
+      int cx = x2[i] * (1 << S), cy = y2[i] * (1 << S);
+      int tx, ty; bool swap;
+      swap = ay > by; tx = swap ? bx : ax; ty = swap ? by : ay; bx = swap ? ax : bx; by = swap ? ay : by; ax = tx; ay = ty;
+      swap = by > cy; tx = swap ? cx : bx; ty = swap ? cy : by; cx = swap ? bx : cx; cy = swap ? by : cy; bx = tx; by = ty;
+      swap = ay > by; tx = swap ? bx : ax; ty = swap ? by : ay; bx = swap ? ax : bx; by = swap ? ay : by; ax = tx; ay = ty;
+      sx0[i] = ax; sy0[i] = ay; sx1[i] = bx; sy1[i] = by; sx2[i] = cx; sy2[i] = cy;
+      int64_t area2 = ((int64_t)bx - ax) * ((int64_t)cy - ay) - ((int64_t)by - ay) * ((int64_t)cx - ax);
+      middle_left[i] = area2 < 0;
+      int lo = x0[i] < x1[i] ? x0[i] : x1[i]; xmin[i] = lo < x2[i] ? lo : x2[i];
+      int hi = x0[i] > x1[i] ? x0[i] : x1[i]; xmax[i] = hi > x2[i] ? hi : x2[i];
+      ymin[i] = y0[i] < y1[i] ? y0[i] : y1[i]; ymin[i] = ymin[i] < y2[i] ? ymin[i] : y2[i];
+      ymax[i] = y0[i] > y1[i] ? y0[i] : y1[i]; ymax[i] = ymax[i] > y2[i] ? ymax[i] : y2[i];
+      visible[i] = (xmax[i] >= clip->x0) & (xmin[i] <= clip->x1) & (ymax[i] >= clip->y0) & (ymin[i] <= clip->y1) & (area2 != 0);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      if (!visible[i]) continue;
+      shader.context = (void*)&batch->colors[start + i];
+      __pastel_canvas_damage(canvas, xmin[i], ymin[i], xmax[i], ymax[i]);
+      __pastel_fill_triangle_sorted(canvas, sx0[i], sy0[i], sx1[i], sy1[i], sx2[i], sy2[i],
+                                    middle_left[i], 0.0f, 0.0, 0.0, false, shader);
+    }
+  }
+}
+
+// A vertex of a mesh, processed once for all the triangles using it.
+typedef struct {
+  uint32_t index;
+  Vec2i p;          // subpixel coordinates
+  unsigned outcode; // on which sides of the clip rectangle the vertex is
+} __PastelMeshVertex;
+
+#define __PASTEL_OUTCODE_LEFT   (1u << 0)
+#define __PASTEL_OUTCODE_RIGHT  (1u << 1)
+#define __PASTEL_OUTCODE_TOP    (1u << 2)
+#define __PASTEL_OUTCODE_BOTTOM (1u << 3)
+
+typedef struct {
+  const PastelCanvas* canvas;
+  const Vec2i* verts;
+  size_t nverts;
+  __PastelMeshVertex cache[PASTEL_MESH_CACHE_SIZE];
+} __PastelMesh;
+
+PASTELDEF void __pastel_mesh_init(__PastelMesh* mesh, const PastelCanvas* canvas, const Vec2i* verts, size_t nverts) {
+  mesh->canvas = canvas;
+  mesh->verts = verts;
+  mesh->nverts = nverts;
+  for (size_t i = 0; i < PASTEL_MESH_CACHE_SIZE; ++i) mesh->cache[i].index = UINT32_MAX;
+}
+
+// @return the processed vertex `index`, or NULL if it is out of the mesh.
+PASTELDEF const __PastelMeshVertex* __pastel_mesh_vertex(__PastelMesh* mesh, uint32_t index) {
+  if (index >= mesh->nverts) return NULL;
+  __PastelMeshVertex* vertex = &mesh->cache[index % PASTEL_MESH_CACHE_SIZE];
+  if (vertex->index == index) return vertex;
+  const Vec2i* v = &mesh->verts[index];
+  const PastelRect* clip = &mesh->canvas->clip;
+  vertex->index = index;
+  vertex->p.x = v->x * (1 << PASTEL_SUBPIXEL_BITS);
+  vertex->p.y = v->y * (1 << PASTEL_SUBPIXEL_BITS);
+  vertex->outcode = (v->x < clip->x0 ? __PASTEL_OUTCODE_LEFT : 0)
+                  | (v->x > clip->x1 ? __PASTEL_OUTCODE_RIGHT : 0)
+                  | (v->y < clip->y0 ? __PASTEL_OUTCODE_TOP : 0)
+                  | (v->y > clip->y1 ? __PASTEL_OUTCODE_BOTTOM : 0);
+  return vertex;
+}
+
+PASTELDEF void __pastel_mesh_triangle(PastelCanvas* canvas, __PastelMesh* mesh, uint32_t i0, uint32_t i1, uint32_t i2, PastelShader shader) {
+  // Each vertex is copied as soon as it is processed: the next ones may evict it
+  // from the cache, e.g i0 and i0 + PASTEL_MESH_CACHE_SIZE.
+  __PastelMeshVertex v[3];
+  uint32_t indices[3] = { i0, i1, i2 };
+  for (int i = 0; i < 3; ++i) {
+    const __PastelMeshVertex* vertex = __pastel_mesh_vertex(mesh, indices[i]);
+    if (vertex == NULL) return;
+    v[i] = *vertex;
+  }
+  if (v[0].outcode & v[1].outcode & v[2].outcode) return; // outside of the clip rectangle
+  pastel_fill_triangle_subpixel(canvas, &v[0].p, &v[1].p, &v[2].p, shader);
+}
+
+PASTELDEF void pastel_draw_mesh(PastelCanvas* canvas, const Vec2i* verts, size_t nverts, const uint32_t* indices, size_t nidx, PastelShader shader) {
+  __PastelMesh mesh;
+  __pastel_mesh_init(&mesh, canvas, verts, nverts);
+  for (size_t k = 0; k + 2 < nidx; k += 3) {
+    if (indices) {
+      __pastel_mesh_triangle(canvas, &mesh, indices[k], indices[k + 1], indices[k + 2], shader);
+    } else {
+      __pastel_mesh_triangle(canvas, &mesh, (uint32_t)k, (uint32_t)k + 1, (uint32_t)k + 2, shader);
+    }
+  }
+}
+
+PASTELDEF void pastel_draw_mesh_strip(PastelCanvas* canvas, const Vec2i* verts, size_t nverts, const uint32_t* indices, size_t nidx, PastelShader shader) {
+  __PastelMesh mesh;
+  __pastel_mesh_init(&mesh, canvas, verts, nverts);
+  for (size_t k = 0; k + 2 < nidx; ++k) {
+    if (indices) {
+      __pastel_mesh_triangle(canvas, &mesh, indices[k], indices[k + 1], indices[k + 2], shader);
+    } else {
+      __pastel_mesh_triangle(canvas, &mesh, (uint32_t)k, (uint32_t)k + 1, (uint32_t)k + 2, shader);
+    }
+  }
+}
+
+PASTELDEF void pastel_draw_mesh_fan(PastelCanvas* canvas, const Vec2i* verts, size_t nverts, const uint32_t* indices, size_t nidx, PastelShader shader) {
+  __PastelMesh mesh;
+  __pastel_mesh_init(&mesh, canvas, verts, nverts);
+  for (size_t k = 0; k + 2 < nidx; ++k) {
+    if (indices) {
+      __pastel_mesh_triangle(canvas, &mesh, indices[0], indices[k + 1], indices[k + 2], shader);
+    } else {
+      __pastel_mesh_triangle(canvas, &mesh, 0, (uint32_t)k + 1, (uint32_t)k + 2, shader);
+    }
+  }
+}
+
+#ifdef PASTEL_THREADS
+// Take tasks until there is none left. Called with the pool mutex locked.
+PASTELDEF void __pastel_thread_pool_work(PastelThreadPool* pool) {
+  while (pool->next_task < pool->task_count) {
+    size_t task = pool->next_task++;
+    pthread_mutex_unlock(&pool->mutex);
+    pool->job(task, pool->job_context);
+    pthread_mutex_lock(&pool->mutex);
+    if (++pool->tasks_done == pool->task_count) pthread_cond_broadcast(&pool->done_cond);
+  }
+}
+
+PASTELDEF void* __pastel_thread_pool_worker(void* arg) {
+  PastelThreadPool* pool = (PastelThreadPool*)arg;
+  size_t generation = 0;
+  pthread_mutex_lock(&pool->mutex);
+  for (;;) {
+    while (!pool->quit && pool->generation == generation) {
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+    }
+    if (pool->quit) break;
+    generation = pool->generation;
+    __pastel_thread_pool_work(pool);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return NULL;
+}
+
+PASTELDEF bool pastel_thread_pool_init(PastelThreadPool* pool, size_t thread_count) {
+  pool->thread_count = 0;
+  pool->job = NULL;
+  pool->job_context = NULL;
+  pool->task_count = 0;
+  pool->next_task = 0;
+  pool->tasks_done = 0;
+  pool->generation = 0;
+  pool->quit = false;
+  if (pthread_mutex_init(&pool->mutex, NULL) != 0) return false;
+  if (pthread_cond_init(&pool->work_cond, NULL) != 0) {
+    pthread_mutex_destroy(&pool->mutex);
+    return false;
+  }
+  if (pthread_cond_init(&pool->done_cond, NULL) != 0) {
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    return false;
+  }
+  if (thread_count > PASTEL_MAX_THREADS) thread_count = PASTEL_MAX_THREADS;
+  for (size_t i = 1; i < thread_count; ++i) {
+    if (pthread_create(&pool->threads[pool->thread_count], NULL, __pastel_thread_pool_worker, pool) != 0) {
+      pastel_thread_pool_destroy(pool);
+      return false;
+    }
+    pool->thread_count++;
+  }
+  return true;
+}
+
+PASTELDEF void pastel_thread_pool_destroy(PastelThreadPool* pool) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->quit = true;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+  for (size_t i = 0; i < pool->thread_count; ++i) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  pool->thread_count = 0;
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_mutex_destroy(&pool->mutex);
+}
+
+PASTELDEF void pastel_thread_pool_run(PastelThreadPool* pool, void (*job)(size_t task, void* context), void* context, size_t task_count) {
+  if (task_count == 0) return;
+  if (pool->thread_count == 0 || task_count == 1) {
+    for (size_t task = 0; task < task_count; ++task) job(task, context);
+    return;
+  }
+  pthread_mutex_lock(&pool->mutex);
+  pool->job = job;
+  pool->job_context = context;
+  pool->task_count = task_count;
+  pool->next_task = 0;
+  pool->tasks_done = 0;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->work_cond);
+  __pastel_thread_pool_work(pool);
+  while (pool->tasks_done < pool->task_count) {
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+typedef struct {
+  PastelCanvas* canvas;
+  PastelShader shader;
+  int band_rows;
+  bool blend;
+} __PastelFillJob;
+
+// Fill the band of rows number `task` of the clip rectangle.
+// Every row is shaded exactly like in the serial functions, hence the same pixels.
+PASTELDEF void __pastel_fill_band(size_t task, void* context) {
+  __PastelFillJob* job = (__PastelFillJob*)context;
+  const PastelRect* clip = &job->canvas->clip;
+  int y0 = clip->y0 + (int)task * job->band_rows;
+  int y1;
+  PASTEL_MIN2(y1, y0 + job->band_rows - 1, clip->y1);
+  for (int y = y0; y <= y1; ++y) {
+    if (job->blend) {
+      __pastel_blend_shader_span(job->canvas, clip->x0, clip->x1, y, job->shader);
+    } else {
+      __pastel_fill_shader_span(job->canvas, clip->x0, clip->x1, y, job->shader);
+    }
+  }
+}
+
+PASTELDEF void __pastel_fill_parallel(PastelThreadPool* pool, PastelCanvas* canvas, PastelShader shader, bool blend) {
+  const PastelRect* clip = &canvas->clip;
+  if (clip->x0 > clip->x1 || clip->y0 > clip->y1) return;
+  __pastel_canvas_damage(canvas, clip->x0, clip->y0, clip->x1, clip->y1);
+  int rows = clip->y1 - clip->y0 + 1;
+  int band_rows = (int)(PASTEL_THREAD_BAND_BYTES / ((size_t)(clip->x1 - clip->x0 + 1) * sizeof(Color)));
+  PASTEL_MAX2(band_rows, band_rows, 1);
+  __PastelFillJob job = { canvas, shader, band_rows, blend };
+  pastel_thread_pool_run(pool, __pastel_fill_band, &job, (size_t)((rows + band_rows - 1) / band_rows));
+}
+
+PASTELDEF void pastel_fill_parallel(PastelThreadPool* pool, PastelCanvas* canvas, PastelShader shader) {
+  __pastel_fill_parallel(pool, canvas, shader, false);
+}
+
+PASTELDEF void pastel_fill_blend_parallel(PastelThreadPool* pool, PastelCanvas* canvas, PastelShader shader) {
+  __pastel_fill_parallel(pool, canvas, shader, true);
+}
+#endif // PASTEL_THREADS
+
+PASTELDEF PastelCommandList pastel_command_list_create(PastelCanvas* canvas, PastelCommand* commands, size_t commands_capacity, uint32_t* bins, size_t bins_capacity) {
+  PastelCommandList list = {
+    .canvas = canvas,
+    .commands = commands,
+    .commands_capacity = commands_capacity,
+    .count = 0,
+    .bins = bins,
+    .bins_capacity = bins_capacity,
+    .msaa = NULL,
+    .msaa_count = 0,
+#ifdef PASTEL_THREADS
+    .pool = NULL,
+#endif
+  };
+  return list;
+}
+
+PASTELDEF void pastel_command_list_set_msaa(PastelCommandList* list, PastelMsaaTile* tiles, size_t tiles_count) {
+  list->msaa = tiles_count > 0 ? tiles : NULL;
+  list->msaa_count = tiles != NULL ? tiles_count : 0;
+}
+
+// Append a command whose primitive lies in `bounds`, once clipped.
+PASTELDEF PastelCommand* __pastel_command_list_push(PastelCommandList* list, PastelCommandType type, PastelShader shader, int x0, int y0, int x1, int y1) {
+  const PastelRect* clip = &list->canvas->clip;
+  PastelRect bounds;
+  PASTEL_MAX2(bounds.x0, x0, clip->x0);
+  PASTEL_MAX2(bounds.y0, y0, clip->y0);
+  PASTEL_MIN2(bounds.x1, x1, clip->x1);
+  PASTEL_MIN2(bounds.y1, y1, clip->y1);
+  if (bounds.x0 > bounds.x1 || bounds.y0 > bounds.y1) return NULL;
+  pastel_canvas_add_damage(list->canvas, &bounds);
+  if (list->count == list->commands_capacity) pastel_command_list_render(list);
+  if (list->commands_capacity == 0) return NULL;
+  PastelCommand* command = &list->commands[list->count++];
+  command->type = type;
+  command->shader = shader;
+  command->bounds = bounds;
+  return command;
+}
+
+PASTELDEF void pastel_command_list_fill(PastelCommandList* list, PastelShader shader) {
+  const PastelRect* clip = &list->canvas->clip;
+  __pastel_command_list_push(list, PASTEL_COMMAND_FILL, shader, clip->x0, clip->y0, clip->x1, clip->y1);
+}
+
+PASTELDEF void pastel_command_list_fill_blend(PastelCommandList* list, PastelShader shader) {
+  const PastelRect* clip = &list->canvas->clip;
+  __pastel_command_list_push(list, PASTEL_COMMAND_FILL_BLEND, shader, clip->x0, clip->y0, clip->x1, clip->y1);
+}
+
+PASTELDEF void pastel_command_list_fill_rect(PastelCommandList* list, const Vec2i* p, const Vec2ui* dim_rect, PastelShader shader) {
+  PastelCommand* command = __pastel_command_list_push(list, PASTEL_COMMAND_FILL_RECT, shader,
+                                                      p->x, p->y, p->x + (int)dim_rect->x, p->y + (int)dim_rect->y);
+  if (command == NULL) return;
+  command->p[0] = *p;
+  command->dim_rect = *dim_rect;
+}
+
+PASTELDEF void pastel_command_list_fill_circle(PastelCommandList* list, const Vec2i* p, size_t r, PastelShader shader) {
+  PastelCommand* command = __pastel_command_list_push(list, PASTEL_COMMAND_FILL_CIRCLE, shader,
+                                                      p->x - (int)r, p->y - (int)r, p->x + (int)r, p->y + (int)r);
+  if (command == NULL) return;
+  command->p[0] = *p;
+  command->r = r;
+}
+
+PASTELDEF void pastel_command_list_draw_line(PastelCommandList* list, const Vec2i* p1, const Vec2i* p2, PastelShader shader) {
+  PastelRect bounds = __pastel_line_bounds(p1, p2);
+  PastelCommand* command = __pastel_command_list_push(list, PASTEL_COMMAND_DRAW_LINE, shader, bounds.x0, bounds.y0, bounds.x1, bounds.y1);
+  if (command == NULL) return;
+  command->p[0] = *p1;
+  command->p[1] = *p2;
+}
+
+PASTELDEF void __pastel_command_list_triangle(PastelCommandList* list, PastelCommandType type, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
+  int aabb_x0, aabb_y0, aabb_x1, aabb_y1;
+  PASTEL_MIN3(aabb_x0, p1->x, p2->x, p3->x);
+  PASTEL_MIN3(aabb_y0, p1->y, p2->y, p3->y);
+  PASTEL_MAX3(aabb_x1, p1->x, p2->x, p3->x);
+  PASTEL_MAX3(aabb_y1, p1->y, p2->y, p3->y);
+  PastelCommand* command = __pastel_command_list_push(list, type, shader, aabb_x0, aabb_y0, aabb_x1, aabb_y1);
+  if (command == NULL) return;
+  command->p[0] = *p1;
+  command->p[1] = *p2;
+  command->p[2] = *p3;
+}
+
+PASTELDEF void pastel_command_list_fill_triangle(PastelCommandList* list, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
+  __pastel_command_list_triangle(list, PASTEL_COMMAND_FILL_TRIANGLE, p1, p2, p3, shader);
+}
+
+PASTELDEF void pastel_command_list_fill_triangle_subpixel(PastelCommandList* list, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
+  const int S = PASTEL_SUBPIXEL_BITS;
+  int aabb_x0, aabb_y0, aabb_x1, aabb_y1;
+  PASTEL_MIN3(aabb_x0, p1->x, p2->x, p3->x);
+  PASTEL_MIN3(aabb_y0, p1->y, p2->y, p3->y);
+  PASTEL_MAX3(aabb_x1, p1->x, p2->x, p3->x);
+  PASTEL_MAX3(aabb_y1, p1->y, p2->y, p3->y);
+  // The samples of multisample rendering are up to 6/16 of pixel from the pixel centers.
+  const int margin = 6 * (1 << S) / 16;
+  PastelCommand* command = __pastel_command_list_push(list, PASTEL_COMMAND_FILL_TRIANGLE_SUBPIXEL, shader,
+                                                      __pastel_ceil_fixed(aabb_x0 - margin, S), __pastel_ceil_fixed(aabb_y0 - margin, S),
+                                                      __pastel_ceil_fixed(aabb_x1, S), __pastel_ceil_fixed(aabb_y1, S));
+  if (command == NULL) return;
+  command->p[0] = *p1;
+  command->p[1] = *p2;
+  command->p[2] = *p3;
+}
+
+PASTELDEF void pastel_command_list_fill_triangle2_oriented(PastelCommandList* list, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
+  __pastel_command_list_triangle(list, PASTEL_COMMAND_FILL_TRIANGLE2_ORIENTED, p1, p2, p3, shader);
+}
+
+PASTELDEF void pastel_command_list_fill_triangle2(PastelCommandList* list, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, PastelShader shader) {
+  __pastel_command_list_triangle(list, PASTEL_COMMAND_FILL_TRIANGLE2, p1, p2, p3, shader);
+}
+
+// Sample offsets from the pixel center, in 1/16 of pixel.
+static const int __pastel_msaa_offsets[4][2] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+
+// Fill a triangle (subpixel vertices, see `pastel_fill_triangle_subpixel`) on the samples
+// of the multisample tile of the canvas. A sample exactly on an edge is covered if the edge
+// is a top or a left one, so triangles sharing an edge cover each of its samples once.
+// Pixels with all their samples covered are drawn as spans, the others shade once
+// and blend on the covered samples only.
+// If `oriented`, the triangle is only drawn with the winding `pastel_fill_triangle2_oriented` accepts.
+PASTELDEF void __pastel_msaa_fill_triangle(PastelCanvas* canvas, const Vec2i* p1, const Vec2i* p2, const Vec2i* p3, bool oriented, PastelShader shader) {
+  const int S = PASTEL_SUBPIXEL_BITS;
+  const PastelRect* clip = &canvas->clip;
+  int64_t vx[3] = { p1->x, p2->x, p3->x };
+  int64_t vy[3] = { p1->y, p2->y, p3->y };
+  int64_t area2 = (vx[1] - vx[0]) * (vy[2] - vy[0]) - (vy[1] - vy[0]) * (vx[2] - vx[0]);
+  if (area2 == 0) return; // degenerate triangle
+  if (oriented && area2 > 0) return; // back-facing
+  if (area2 < 0) {
+    PASTEL_SWAP(int64_t, vx[1], vx[2]);
+    PASTEL_SWAP(int64_t, vy[1], vy[2]);
+  }
+
+  // Sample offsets in subpixels
+  int64_t ox[4], oy[4];
+  for (int k = 0; k < 4; ++k) {
+    ox[k] = (int64_t)__pastel_msaa_offsets[k][0] * (1 << S) / 16;
+    oy[k] = (int64_t)__pastel_msaa_offsets[k][1] * (1 << S) / 16;
+  }
+
+  // Edge i goes from vertex i to vertex i + 1; the inside is where e(x, y) =
+  // (xb - xa) * (y - ya) - (yb - ya) * (x - xa) is > 0, or = 0 on a top-left edge.
+  int64_t ex[3], ey[3], bias[3];
+  for (int i = 0; i < 3; ++i) {
+    int j = (i + 1) % 3;
+    int64_t dx = vx[j] - vx[i], dy = vy[j] - vy[i];
+    ex[i] = -dy;
+    ey[i] = dx;
+    bool top_left = dy < 0 || (dy == 0 && dx > 0);
+    bias[i] = top_left ? 0 : -1;
+  }
+
+  // Pixels whose samples can be in the triangle
+  int64_t xmin = vx[0], xmax = vx[0], ymin = vy[0], ymax = vy[0];
+  for (int i = 1; i < 3; ++i) {
+    if (vx[i] < xmin) xmin = vx[i];
+    if (vx[i] > xmax) xmax = vx[i];
+    if (vy[i] < ymin) ymin = vy[i];
+    if (vy[i] > ymax) ymax = vy[i];
+  }
+  const int64_t margin = 6 * (1 << S) / 16;
+  int px0, py0, px1, py1;
+  PASTEL_MAX2(px0, __pastel_ceil_fixed(xmin - margin, S), clip->x0);
+  PASTEL_MAX2(py0, __pastel_ceil_fixed(ymin - margin, S), clip->y0);
+  PASTEL_MIN2(px1, -__pastel_ceil_fixed(-(xmax + margin), S), clip->x1);
+  PASTEL_MIN2(py1, -__pastel_ceil_fixed(-(ymax + margin), S), clip->y1);
+
+  for (int y = py0; y <= py1; ++y) {
+    // Edge functions at the samples of pixel (px0, y)
+    int64_t e[3][4];
+    for (int i = 0; i < 3; ++i) {
+      int64_t cx = (int64_t)px0 * (1 << S) - vx[i];
+      int64_t cy = (int64_t)y * (1 << S) - vy[i];
+      for (int k = 0; k < 4; ++k) e[i][k] = ex[i] * (cx + ox[k]) + ey[i] * (cy + oy[k]) + bias[i];
+    }
+    int span_x0 = px1 + 1; // start of the current span of fully covered pixels
+    for (int x = px0; x <= px1; ++x) {
+      unsigned mask = 0;
+      for (int k = 0; k < 4; ++k) {
+        mask |= (unsigned)((e[0][k] >= 0) & (e[1][k] >= 0) & (e[2][k] >= 0)) << k;
+      }
+      if (mask == 0xF) {
+        if (span_x0 > x) span_x0 = x;
+      } else {
+        if (span_x0 < x) {
+          __pastel_blend_shader_span(canvas, span_x0, x - 1, y, shader);
+          span_x0 = px1 + 1;
+        }
+        if (mask != 0) {
+          Color color = pastel_shader_run(shader, x, y);
+          __pastel_convert_shader_span(canvas, shader, &color, 1);
+          __pastel_msaa_blend_samples(canvas, x, y, color, mask);
+        }
+      }
+      for (int i = 0; i < 3; ++i) {
+        int64_t step = ex[i] * (1 << S);
+        for (int k = 0; k < 4; ++k) e[i][k] += step;
+      }
+    }
+    __pastel_blend_shader_span(canvas, span_x0, px1, y, shader);
+  }
+}
+
+// Start a multisample tile: the samples of each pixel are its current color.
+PASTELDEF void __pastel_msaa_load(const PastelCanvas* canvas, PastelMsaaTile* tile, const PastelRect* rect) {
+  tile->rect = *rect;
+  for (int y = rect->y0; y <= rect->y1; ++y) {
+    Color* samples = __PASTEL_MSAA_SAMPLES(tile, rect->x0, y);
+    const Color* row = &PASTEL_PIXEL(canvas, 0, y);
+    for (int x = rect->x0; x <= rect->x1; ++x, samples += 4) __pastel_fill_color_span(samples, row[x], 4);
+  }
+}
+
+// Write the mean of the 4 samples of each pixel of the tile to the canvas.
+PASTELDEF void __pastel_msaa_resolve(PastelCanvas* canvas, const PastelMsaaTile* tile) {
+  const PastelRect* rect = &tile->rect;
+  for (int y = rect->y0; y <= rect->y1; ++y) {
+    const Color* samples = __PASTEL_MSAA_SAMPLES(tile, rect->x0, y);
+    pastel_average4_span(&PASTEL_PIXEL(canvas, rect->x0, y), samples, (size_t)(rect->x1 - rect->x0 + 1));
+  }
+}
+
+// Draw a command with the immediate functions, clipped to `tile`.
+// The canvas is a copy owned by the tile, so tiles can be drawn concurrently.
+PASTELDEF void __pastel_command_draw(PastelCanvas* canvas, const PastelCommand* command, const PastelRect* tile) {
+  PastelRect* clip = &canvas->clip;
+  PASTEL_MAX2(clip->x0, command->bounds.x0, tile->x0);
+  PASTEL_MAX2(clip->y0, command->bounds.y0, tile->y0);
+  PASTEL_MIN2(clip->x1, command->bounds.x1, tile->x1);
+  PASTEL_MIN2(clip->y1, command->bounds.y1, tile->y1);
+  if (clip->x0 > clip->x1 || clip->y0 > clip->y1) return;
+  const Vec2i* p = command->p;
+  if (canvas->msaa) {
+    // Triangles are rasterized on the samples
+    const int S = PASTEL_SUBPIXEL_BITS;
+    Vec2i q[3];
+    for (int i = 0; i < 3; ++i) {
+      q[i].x = command->type == PASTEL_COMMAND_FILL_TRIANGLE_SUBPIXEL ? p[i].x : p[i].x * (1 << S);
+      q[i].y = command->type == PASTEL_COMMAND_FILL_TRIANGLE_SUBPIXEL ? p[i].y : p[i].y * (1 << S);
+    }
+    switch (command->type) {
+    case PASTEL_COMMAND_FILL_TRIANGLE:
+    case PASTEL_COMMAND_FILL_TRIANGLE_SUBPIXEL:
+    case PASTEL_COMMAND_FILL_TRIANGLE2_ORIENTED:
+    case PASTEL_COMMAND_FILL_TRIANGLE2:
+      __pastel_msaa_fill_triangle(canvas, &q[0], &q[1], &q[2],
+                                  command->type == PASTEL_COMMAND_FILL_TRIANGLE2_ORIENTED, command->shader);
+      return;
+    default:
+      break;
+    }
+  }
+  switch (command->type) {
+  case PASTEL_COMMAND_FILL:                    pastel_fill(canvas, command->shader); break;
+  case PASTEL_COMMAND_FILL_BLEND:              pastel_fill_blend(canvas, command->shader); break;
+  case PASTEL_COMMAND_FILL_RECT:               pastel_fill_rect(canvas, &p[0], &command->dim_rect, command->shader); break;
+  case PASTEL_COMMAND_FILL_CIRCLE:             pastel_fill_circle(canvas, &p[0], command->r, command->shader); break;
+  case PASTEL_COMMAND_DRAW_LINE:               pastel_draw_line(canvas, &p[0], &p[1], command->shader); break;
+  case PASTEL_COMMAND_FILL_TRIANGLE:           pastel_fill_triangle(canvas, &p[0], &p[1], &p[2], command->shader); break;
+  case PASTEL_COMMAND_FILL_TRIANGLE_SUBPIXEL:  pastel_fill_triangle_subpixel(canvas, &p[0], &p[1], &p[2], command->shader); break;
+  case PASTEL_COMMAND_FILL_TRIANGLE2_ORIENTED: pastel_fill_triangle2_oriented(canvas, &p[0], &p[1], &p[2], command->shader); break;
+  case PASTEL_COMMAND_FILL_TRIANGLE2:          pastel_fill_triangle2(canvas, &p[0], &p[1], &p[2], command->shader); break;
+  }
+}
+
+typedef struct {
+  PastelCommandList* list;
+  size_t tiles_x;
+  bool binned;
+  size_t tiles_count;
+  size_t msaa_count; // number of multisample tiles in use
+} __PastelRenderJob;
+
+// Draw, in order, the commands overlapping the tile number `task`,
+// on the samples of `msaa` if not NULL.
+PASTELDEF void __pastel_render_tile_samples(__PastelRenderJob* job, size_t task, PastelMsaaTile* msaa) {
+  PastelCommandList* list = job->list;
+  PastelCanvas canvas = *list->canvas;
+  PastelRect tile;
+  tile.x0 = (int)(task % job->tiles_x) * PASTEL_TILE_SIZE;
+  tile.y0 = (int)(task / job->tiles_x) * PASTEL_TILE_SIZE;
+  PASTEL_MIN2(tile.x1, tile.x0 + PASTEL_TILE_SIZE - 1, (int)canvas.width - 1);
+  PASTEL_MIN2(tile.y1, tile.y0 + PASTEL_TILE_SIZE - 1, (int)canvas.height - 1);
+  // Unbinned, every command is drawn clipped to the tile.
+  const uint32_t* indices = NULL;
+  size_t begin = 0, end = list->count;
+  if (job->binned) {
+    // See `__pastel_bin_commands`: the bin of the tile ends at bins[task].
+    size_t tiles_count = job->tiles_x * ((canvas.height + PASTEL_TILE_SIZE - 1) / PASTEL_TILE_SIZE);
+    indices = list->bins + tiles_count + 1;
+    begin = task == 0 ? 0 : list->bins[task - 1];
+    end = list->bins[task];
+    // Nothing to draw: the samples of an empty tile are neither loaded nor resolved.
+    if (begin == end) return;
+  }
+  if (msaa) {
+    __pastel_msaa_load(&canvas, msaa, &tile);
+    canvas.msaa = msaa;
+  }
+  for (size_t i = begin; i < end; ++i) {
+    __pastel_command_draw(&canvas, &list->commands[indices ? indices[i] : i], &tile);
+  }
+  if (msaa) __pastel_msaa_resolve(&canvas, msaa);
+}
+
+PASTELDEF void __pastel_render_tile(size_t task, void* context) {
+  __pastel_render_tile_samples((__PastelRenderJob*)context, task, NULL);
+}
+
+// Multisample rendering: task i owns the multisample tile i and renders
+// the tiles i, i + msaa_count, i + 2 * msaa_count...
+PASTELDEF void __pastel_render_tiles_msaa(size_t task, void* context) {
+  __PastelRenderJob* job = (__PastelRenderJob*)context;
+  for (size_t t = task; t < job->tiles_count; t += job->msaa_count) {
+    __pastel_render_tile_samples(job, t, &job->list->msaa[task]);
+  }
+}
+
+// Counting sort of the commands by tile, keeping the recording order in each tile.
+// `bins` starts with tiles_count + 1 offsets, followed by the command indices.
+// After the sort, the indices of tile t are [bins[t - 1], bins[t]) (starting at 0 for t = 0).
+// @return false if `bins` is too small.
+PASTELDEF bool __pastel_bin_commands(PastelCommandList* list, size_t tiles_x, size_t tiles_count) {
+  if (list->bins_capacity < tiles_count + 1) return false;
+  uint32_t* offsets = list->bins;
+  uint32_t* indices = list->bins + tiles_count + 1;
+  size_t indices_capacity = list->bins_capacity - (tiles_count + 1);
+  for (size_t t = 0; t <= tiles_count; ++t) offsets[t] = 0;
+  size_t total = 0;
+  for (size_t i = 0; i < list->count; ++i) {
+    const PastelRect* b = &list->commands[i].bounds;
+    for (int ty = b->y0 / PASTEL_TILE_SIZE; ty <= b->y1 / PASTEL_TILE_SIZE; ++ty) {
+      for (int tx = b->x0 / PASTEL_TILE_SIZE; tx <= b->x1 / PASTEL_TILE_SIZE; ++tx) {
+        offsets[(size_t)ty * tiles_x + (size_t)tx + 1]++;
+      }
+    }
+    total += (size_t)(b->y1 / PASTEL_TILE_SIZE - b->y0 / PASTEL_TILE_SIZE + 1)
+           * (size_t)(b->x1 / PASTEL_TILE_SIZE - b->x0 / PASTEL_TILE_SIZE + 1);
+  }
+  if (total > indices_capacity) return false;
+  for (size_t t = 1; t <= tiles_count; ++t) offsets[t] += offsets[t - 1];
+  for (size_t i = 0; i < list->count; ++i) {
+    const PastelRect* b = &list->commands[i].bounds;
+    for (int ty = b->y0 / PASTEL_TILE_SIZE; ty <= b->y1 / PASTEL_TILE_SIZE; ++ty) {
+      for (int tx = b->x0 / PASTEL_TILE_SIZE; tx <= b->x1 / PASTEL_TILE_SIZE; ++tx) {
+        indices[offsets[(size_t)ty * tiles_x + (size_t)tx]++] = (uint32_t)i;
+      }
+    }
+  }
+  return true;
+}
+
+PASTELDEF void pastel_command_list_render(PastelCommandList* list) {
+  if (list->count == 0) return;
+  PastelCanvas* canvas = list->canvas;
+  size_t tiles_x = (canvas->width + PASTEL_TILE_SIZE - 1) / PASTEL_TILE_SIZE;
+  size_t tiles_y = (canvas->height + PASTEL_TILE_SIZE - 1) / PASTEL_TILE_SIZE;
+  size_t tiles_count = tiles_x * tiles_y;
+  __PastelRenderJob job = { list, tiles_x, __pastel_bin_commands(list, tiles_x, tiles_count), tiles_count, 1 };
+  if (list->msaa != NULL) {
+#ifdef PASTEL_THREADS
+    if (list->pool != NULL) {
+      PASTEL_MIN2(job.msaa_count, list->msaa_count, tiles_count);
+      pastel_thread_pool_run(list->pool, __pastel_render_tiles_msaa, &job, job.msaa_count);
+      list->count = 0;
+      return;
+    }
+#endif
+    __pastel_render_tiles_msaa(0, &job);
+    list->count = 0;
+    return;
+  }
+#ifdef PASTEL_THREADS
+  if (list->pool != NULL) {
+    pastel_thread_pool_run(list->pool, __pastel_render_tile, &job, tiles_count);
+    list->count = 0;
+    return;
+  }
+#endif
+  for (size_t t = 0; t < tiles_count; ++t) __pastel_render_tile(t, &job);
+  list->count = 0;
+}
+
 #endif // PASTEL_IMPLEMENTATION
@@ -0,0 +1,409 @@
+#ifndef PASTEL_HPP_
+#define PASTEL_HPP_
+//
+// C++ front end of pastel.h.
+//
+// In pastel.h, a shader is a function pointer with a `void*` context:
+// the compiler cannot inline it, so every pixel of every primitive pays
+// for an indirect call and the blending can't be vectorized with the shading.
+//
+// Here, the rasterizers are templates on:
+//   - a shader functor: anything callable as `Color shader(int x, int y)`,
+//     e.g a lambda or one of the shaders below.
+//   - a blend policy: a struct with `static void blend(Color* dst, Color src)`.
+// Both are known at compile time, so the shader and the blend end up fused
+// in the same inner loop, which the compiler is free to vectorize.
+// The pixels produced are the same as the ones of the C API.
+//
+// Usage:
+//     #define PASTEL_IMPLEMENTATION
+//     #include "pastel.hpp"
+//
+//     pastel::Monochrome red = { pastel::colors::red };
+//     pastel::fill_rect(canvas, {0, 0}, {10, 10}, red);
+//     pastel::fill_circle<pastel::Replace>(canvas, {50, 50}, 10,
+//                                          [](int x, int y) { return x < y ? pastel::colors::green : pastel::colors::blue; });
+//
+// The colors returned by the shader are written as-is, so on a premultiplied
+// canvas use premultiplied colors and the `PremultipliedBlend` policy.
+//
+
+#include "pastel.h"
+
+namespace pastel {
+
+// ------------------------------------
+// -------------- COLORS --------------
+// ------------------------------------
+constexpr Color rgba(Color r, Color g, Color b, Color a) {
+  return ((a&0xFF)<<(8*3))|((b&0xFF)<<(8*2))|((g&0xFF)<<(8*1))|((r&0xFF)<<(8*0));
+}
+
+namespace colors {
+constexpr Color red    = PASTEL_RED;
+constexpr Color green  = PASTEL_GREEN;
+constexpr Color blue   = PASTEL_BLUE;
+constexpr Color yellow = PASTEL_YELLOW;
+constexpr Color black  = PASTEL_BLACK;
+constexpr Color white  = PASTEL_WHITE;
+} // namespace colors
+
+// ----------------------------------------------
+// -------------- BLEND POLICIES ----------------
+// ----------------------------------------------
+
+// Replace the pixel, like `pastel_fill`.
+struct Replace {
+  static inline void blend(Color* dst, Color src) { *dst = src; }
+};
+
+// Same result as `pastel_blend_colors`, written without branches nor integer
+// divisions so that the compiler can vectorize it
+// (see the SIMD kernels of `pastel_blend_span` for why the float division is exact).
+struct AlphaBlend {
+  static inline void blend(Color* dst, Color src) {
+    Color d = *dst;
+    float sa = (float)(src >> 24);
+    float w2 = sa*255.0f;
+    float w1 = (float)(d >> 24)*(255.0f - sa);
+    float ca = w2 + w1;
+    float ca_safe = ca > 0.0f ? ca : 1.0f;
+    Color r = (Color)(((float)((src >> 0) & 0xFF)*w2 + (float)((d >> 0) & 0xFF)*w1)/ca_safe);
+    Color g = (Color)(((float)((src >> 8) & 0xFF)*w2 + (float)((d >> 8) & 0xFF)*w1)/ca_safe);
+    Color b = (Color)(((float)((src >> 16) & 0xFF)*w2 + (float)((d >> 16) & 0xFF)*w1)/ca_safe);
+    Color a = (Color)(ca/255.0f);
+    Color out = rgba(r, g, b, a);
+    *dst = sa > 0.0f ? out : d;
+  }
+};
+
+// Same result as `pastel_blend_colors_premultiplied`.
+struct PremultipliedBlend {
+  static inline void blend(Color* dst, Color src) { pastel_blend_colors_premultiplied(dst, src); }
+};
+
+// ---------------------------------------
+// -------------- SHADERS ----------------
+// ---------------------------------------
+struct Monochrome {
+  Color color;
+  constexpr Color operator()(int x, int y) const { PASTEL_UNUSED(x); PASTEL_UNUSED(y); return color; }
+};
+
+// Same colors as `pastel_shader_func_gradient1dx` / `pastel_shader_func_gradient1dy`.
+constexpr Color gradient1d(int v, int vmin, int vmax, Color c1, Color c2) {
+  if (v < vmin) v = vmin;
+  if (v > vmax) v = vmax;
+  Color w1 = (Color)(vmax - v);
+  Color w2 = (Color)(v - vmin);
+  Color d = (Color)(vmax - vmin);
+  Color r = (w1*((c1 >> 0) & 0xFF) + w2*((c2 >> 0) & 0xFF))/d;
+  Color g = (w1*((c1 >> 8) & 0xFF) + w2*((c2 >> 8) & 0xFF))/d;
+  Color b = (w1*((c1 >> 16) & 0xFF) + w2*((c2 >> 16) & 0xFF))/d;
+  Color a = (w1*((c1 >> 24) & 0xFF) + w2*((c2 >> 24) & 0xFF))/d;
+  return rgba(r > 255 ? 255 : r, g > 255 ? 255 : g, b > 255 ? 255 : b, a > 255 ? 255 : a);
+}
+
+struct Gradient1DX {
+  Color c1; Color c2; int min; int max;
+  constexpr Color operator()(int x, int y) const { PASTEL_UNUSED(y); return gradient1d(x, min, max, c1, c2); }
+};
+
+struct Gradient1DY {
+  Color c1; Color c2; int min; int max;
+  constexpr Color operator()(int x, int y) const { PASTEL_UNUSED(x); return gradient1d(y, min, max, c1, c2); }
+};
+
+// ------------------------------------------
+// -------------- RASTERIZERS ---------------
+// ------------------------------------------
+// Same primitives as in pastel.h, see there for their documentation.
+
+template <class Blend = Replace, class Shader>
+inline void fill(PastelCanvas& canvas, Shader&& shader);
+
+template <class Blend = AlphaBlend, class Shader>
+inline void fill_blend(PastelCanvas& canvas, Shader&& shader);
+
+template <class Blend = AlphaBlend, class Shader>
+inline void fill_rect(PastelCanvas& canvas, Vec2i p, Vec2ui dim_rect, Shader&& shader);
+
+template <class Blend = AlphaBlend, class Shader>
+inline void fill_circle(PastelCanvas& canvas, Vec2i p, size_t r, Shader&& shader);
+
+template <class Blend = AlphaBlend, class Shader>
+inline void draw_line(PastelCanvas& canvas, Vec2i p1, Vec2i p2, Shader&& shader);
+
+template <class Blend = AlphaBlend, class Shader>
+inline void fill_triangle(PastelCanvas& canvas, Vec2i p1, Vec2i p2, Vec2i p3, Shader&& shader);
+
+template <class Blend = AlphaBlend, class Shader>
+inline void fill_triangle_subpixel(PastelCanvas& canvas, Vec2i p1, Vec2i p2, Vec2i p3, Shader&& shader);
+
+template <class Blend = AlphaBlend, class Shader>
+inline void fill_triangle2_oriented(PastelCanvas& canvas, Vec2i p1, Vec2i p2, Vec2i p3, Shader&& shader);
+
+template <class Blend = AlphaBlend, class Shader>
+inline void fill_triangle2(PastelCanvas& canvas, Vec2i p1, Vec2i p2, Vec2i p3, Shader&& shader);
+
+// ----------------------------------------------------------
+// -------------- RASTERIZERS IMPLEMENTATIONS ---------------
+// ----------------------------------------------------------
+namespace detail {
+
+// Shade and blend the pixels [x0, x1] of row y, already clipped to the clip rectangle.
+// This is the loop where shader and blend get fused.
+template <class Blend, class Shader>
+inline void span(PastelCanvas& canvas, int x0, int x1, int y, Shader& shader) {
+  Color* row = &PASTEL_PIXEL(&canvas, 0, y);
+  for (int x = x0; x <= x1; ++x) Blend::blend(&row[x], shader(x, y));
+}
+
+template <class Blend, class Shader>
+inline void pixel(PastelCanvas& canvas, int x, int y, Shader& shader) {
+  Blend::blend(&PASTEL_PIXEL(&canvas, x, y), shader(x, y));
+}
+
+// Emit the runs of consecutive pixels of each row of the (clipped) aabb
+// for which `inside(x, y)` is true.
+template <class Blend, class Inside, class Shader>
+inline void aabb_spans(PastelCanvas& canvas, int aabb_x0, int aabb_y0, int aabb_x1, int aabb_y1, Inside inside, Shader& shader) {
+  PASTEL_MAX2(aabb_x0, aabb_x0, canvas.clip.x0);
+  PASTEL_MAX2(aabb_y0, aabb_y0, canvas.clip.y0);
+  PASTEL_MIN2(aabb_x1, aabb_x1, canvas.clip.x1);
+  PASTEL_MIN2(aabb_y1, aabb_y1, canvas.clip.y1);
+  for (int y = aabb_y0; y <= aabb_y1; ++y) {
+    int span_x0 = aabb_x1 + 1;
+    for (int x = aabb_x0; x <= aabb_x1; ++x) {
+      bool in = inside(x, y);
+      if (in && span_x0 > x) span_x0 = x;
+      if (!in && span_x0 < x) {
+        span<Blend>(canvas, span_x0, x - 1, y, shader);
+        span_x0 = aabb_x1 + 1;
+      }
+    }
+    span<Blend>(canvas, span_x0, aabb_x1, y, shader);
+  }
+}
+
+} // namespace detail
+
+template <class Blend, class Shader>
+inline void fill(PastelCanvas& canvas, Shader&& shader) {
+  const PastelRect& clip = canvas.clip;
+  __pastel_canvas_damage(&canvas, clip.x0, clip.y0, clip.x1, clip.y1);
+  for (int y = clip.y0; y <= clip.y1; ++y) {
+    detail::span<Blend>(canvas, clip.x0, clip.x1, y, shader);
+  }
+}
+
+template <class Blend, class Shader>
+inline void fill_blend(PastelCanvas& canvas, Shader&& shader) {
+  fill<Blend>(canvas, shader);
+}
+
+template <class Blend, class Shader>
+inline void fill_rect(PastelCanvas& canvas, Vec2i p, Vec2ui dim_rect, Shader&& shader) {
+  const PastelRect& clip = canvas.clip;
+  int x0, y0, x1, y1;
+  PASTEL_MAX2(x0, p.x, clip.x0);
+  PASTEL_MAX2(y0, p.y, clip.y0);
+  PASTEL_MIN2(x1, p.x + (int)dim_rect.x, clip.x1);
+  PASTEL_MIN2(y1, p.y + (int)dim_rect.y, clip.y1);
+  __pastel_canvas_damage(&canvas, x0, y0, x1, y1);
+  for (int y = y0; y <= y1; ++y) {
+    detail::span<Blend>(canvas, x0, x1, y, shader);
+  }
+}
+
+template <class Blend, class Shader>
+inline void fill_circle(PastelCanvas& canvas, Vec2i p, size_t r, Shader&& shader) {
+  const PastelRect& clip = canvas.clip;
+  int r2 = (int)(r * r);
+  __pastel_canvas_damage(&canvas, p.x - (int)r, p.y - (int)r, p.x + (int)r, p.y + (int)r);
+  int dx = 0;
+  int dx2_next = 1;
+  for (int dy = (int)r; dy >= 0; --dy) {
+    int dy2 = dy * dy;
+    while (dx2_next + dy2 <= r2) {
+      dx2_next += 2 * dx + 3;
+      ++dx;
+    }
+    int xl, xr;
+    PASTEL_MAX2(xl, p.x - dx, clip.x0);
+    PASTEL_MIN2(xr, p.x + dx, clip.x1);
+    int y = p.y - dy;
+    if (clip.y0 <= y && y <= clip.y1) detail::span<Blend>(canvas, xl, xr, y, shader);
+    y = p.y + dy;
+    if (dy > 0 && clip.y0 <= y && y <= clip.y1) detail::span<Blend>(canvas, xl, xr, y, shader);
+  }
+}
+
+template <class Blend, class Shader>
+inline void draw_line(PastelCanvas& canvas, Vec2i p1, Vec2i p2, Shader&& shader) {
+  const PastelRect& clip = canvas.clip;
+  int x0 = p1.x; int y0 = p1.y;
+  int x1 = p2.x; int y1 = p2.y;
+  PastelRect bounds = __pastel_line_bounds(&p1, &p2);
+  __pastel_canvas_damage(&canvas, bounds.x0, bounds.y0, bounds.x1, bounds.y1);
+  if (x0 == x1) {
+    if (clip.x0 <= x0 && x0 <= clip.x1) {
+      if (y0 > y1) PASTEL_SWAP(int, y0, y1);
+      PASTEL_MAX2(y0, y0, clip.y0);
+      PASTEL_MIN2(y1, y1, clip.y1);
+      for (int y = y0; y <= y1; ++y) detail::pixel<Blend>(canvas, x0, y, shader);
+    }
+  } else if (y0 == y1) {
+    if (clip.y0 <= y0 && y0 <= clip.y1) {
+      if (x0 > x1) PASTEL_SWAP(int, x0, x1);
+      PASTEL_MAX2(x0, x0, clip.x0);
+      PASTEL_MIN2(x1, x1, clip.x1);
+      detail::span<Blend>(canvas, x0, x1, y0, shader);
+    }
+  } else {
+    if (x0 > x1) {
+      PASTEL_SWAP(int, x0, x1);
+      PASTEL_SWAP(int, y0, y1);
+    }
+    int dx = x1 - x0;
+    int dy = y1 - y0;
+    int sy = dy > 0 ? 1 : -1;
+    int ady = dy * sy;
+    int inc = ady / dx;
+    int rem = ady % dx;
+    int kstart, kend;
+    PASTEL_MAX2(kstart, 0, clip.x0 - x0);
+    PASTEL_MIN2(kend, dx, clip.x1 - x0);
+    if (kstart > kend) return;
+    int64_t kq = (int64_t)kstart * ady;
+    int q = (int)(kq / dx);
+    int r = (int)(kq % dx);
+    if (ady < dx) {
+      int span_k = kstart;
+      for (int k = kstart; k <= kend; ++k) {
+        r += rem;
+        if (r < dx) continue;
+        r -= dx;
+        int y = y0 + sy * q;
+        if (clip.y0 <= y && y <= clip.y1) detail::span<Blend>(canvas, x0 + span_k, x0 + k, y, shader);
+        span_k = k;
+        q++;
+      }
+      int y = y0 + sy * q;
+      if (clip.y0 <= y && y <= clip.y1) detail::span<Blend>(canvas, x0 + span_k, x0 + kend, y, shader);
+    } else {
+      for (int k = kstart; k <= kend; ++k) {
+        int qn = q + inc;
+        r += rem;
+        if (r >= dx) {
+          r -= dx;
+          qn++;
+        }
+        int ystart = y0 + sy * q;
+        int yend = y0 + sy * qn;
+        if (ystart > yend) PASTEL_SWAP(int, ystart, yend);
+        PASTEL_MAX2(ystart, ystart, clip.y0);
+        PASTEL_MIN2(yend, yend, clip.y1);
+        for (int y = ystart; y <= yend; ++y) detail::pixel<Blend>(canvas, x0 + k, y, shader);
+        q = qn;
+      }
+    }
+  }
+}
+
+template <class Blend, class Shader>
+inline void fill_triangle2_oriented(PastelCanvas& canvas, Vec2i p1, Vec2i p2, Vec2i p3, Shader&& shader) {
+  int x0 = p1.x; int y0 = p1.y;
+  int x1 = p2.x; int y1 = p2.y;
+  int x2 = p3.x; int y2 = p3.y;
+  int aabb_x0, aabb_y0, aabb_x1, aabb_y1;
+  PASTEL_MIN3(aabb_x0, x0, x1, x2);
+  PASTEL_MIN3(aabb_y0, y0, y1, y2);
+  PASTEL_MAX3(aabb_x1, x0, x1, x2);
+  PASTEL_MAX3(aabb_y1, y0, y1, y2);
+  __pastel_canvas_damage(&canvas, aabb_x0, aabb_y0, aabb_x1, aabb_y1);
+  auto inside = [=](int x, int y) {
+    int d1 = (x - x0) * (y0 - y2) + (y - y0) * (x2 - x0);
+    int d2 = (x - x2) * (y2 - y1) + (y - y2) * (x1 - x2);
+    int d3 = (x - x1) * (y1 - y0) + (y - y1) * (x0 - x1);
+    return d1 >= 0 && d2 >= 0 && d3 >= 0;
+  };
+  detail::aabb_spans<Blend>(canvas, aabb_x0, aabb_y0, aabb_x1, aabb_y1, inside, shader);
+}
+
+template <class Blend, class Shader>
+inline void fill_triangle2(PastelCanvas& canvas, Vec2i p1, Vec2i p2, Vec2i p3, Shader&& shader) {
+  int x0 = p1.x; int y0 = p1.y;
+  int x1 = p2.x; int y1 = p2.y;
+  int x2 = p3.x; int y2 = p3.y;
+  int aabb_x0, aabb_y0, aabb_x1, aabb_y1;
+  PASTEL_MIN3(aabb_x0, x0, x1, x2);
+  PASTEL_MIN3(aabb_y0, y0, y1, y2);
+  PASTEL_MAX3(aabb_x1, x0, x1, x2);
+  PASTEL_MAX3(aabb_y1, y0, y1, y2);
+  __pastel_canvas_damage(&canvas, aabb_x0, aabb_y0, aabb_x1, aabb_y1);
+  auto inside = [=](int x, int y) {
+    int d1 = (x - x0) * (y0 - y2) + (y - y0) * (x2 - x0);
+    int d2 = (x - x2) * (y2 - y1) + (y - y2) * (x1 - x2);
+    int d3 = (x - x1) * (y1 - y0) + (y - y1) * (x0 - x1);
+    bool has_neg = (d1 < 0) || (d2 < 0) || (d3 < 0);
+    bool has_pos = (d1 > 0) || (d2 > 0) || (d3 > 0);
+    return !(has_neg && has_pos);
+  };
+  detail::aabb_spans<Blend>(canvas, aabb_x0, aabb_y0, aabb_x1, aabb_y1, inside, shader);
+}
+
+template <class Blend, class Shader>
+inline void fill_triangle(PastelCanvas& canvas, Vec2i p1, Vec2i p2, Vec2i p3, Shader&& shader) {
+  const int S = PASTEL_SUBPIXEL_BITS;
+  fill_triangle_subpixel<Blend>(canvas, {p1.x * (1 << S), p1.y * (1 << S)}, {p2.x * (1 << S), p2.y * (1 << S)},
+                                {p3.x * (1 << S), p3.y * (1 << S)}, shader);
+}
+
+template <class Blend, class Shader>
+inline void fill_triangle_subpixel(PastelCanvas& canvas, Vec2i p1, Vec2i p2, Vec2i p3, Shader&& shader) {
+  const int S = PASTEL_SUBPIXEL_BITS;
+  int x0 = p1.x; int y0 = p1.y;
+  int x1 = p2.x; int y1 = p2.y;
+  int x2 = p3.x; int y2 = p3.y;
+
+  if (y0 > y1) { PASTEL_SWAP(int, x0, x1); PASTEL_SWAP(int, y0, y1); }
+  if (y1 > y2) { PASTEL_SWAP(int, x1, x2); PASTEL_SWAP(int, y1, y2); }
+  if (y0 > y1) { PASTEL_SWAP(int, x0, x1); PASTEL_SWAP(int, y0, y1); }
+
+  int64_t area2 = ((int64_t)x1 - x0) * ((int64_t)y2 - y0) - ((int64_t)y1 - y0) * ((int64_t)x2 - x0);
+  if (area2 == 0) return; // degenerate triangle
+  bool middle_left = area2 < 0;
+  int xmin, xmax;
+  PASTEL_MIN3(xmin, x0, x1, x2);
+  PASTEL_MAX3(xmax, x0, x1, x2);
+  __pastel_canvas_damage(&canvas, __pastel_ceil_fixed(xmin, S), __pastel_ceil_fixed(y0, S),
+                         __pastel_ceil_fixed(xmax, S), __pastel_ceil_fixed(y2, S));
+
+  const PastelRect& clip = canvas.clip;
+  int ystart, yend;
+  for (int half = 0; half < 2; ++half) {
+    int ya = half == 0 ? y0 : y1;
+    int yb = half == 0 ? y1 : y2;
+    PASTEL_MAX2(ystart, __pastel_ceil_fixed(ya, S), clip.y0);
+    PASTEL_MIN2(yend, __pastel_ceil_fixed(yb, S) - 1, clip.y1);
+    if (ystart > yend) continue;
+    __PastelEdgeWalk long_edge = __pastel_edge_walk(x0, y0, x2, y2, ystart);
+    __PastelEdgeWalk short_edge = half == 0 ? __pastel_edge_walk(x0, y0, x1, y1, ystart)
+                                            : __pastel_edge_walk(x1, y1, x2, y2, ystart);
+    __PastelEdgeWalk& left = middle_left ? short_edge : long_edge;
+    __PastelEdgeWalk& right = middle_left ? long_edge : short_edge;
+    for (int y = ystart; y <= yend; ++y) {
+      int xl, xr;
+      PASTEL_MAX2(xl, __pastel_ceil_fixed(left.x, 16 + S), clip.x0);
+      PASTEL_MIN2(xr, __pastel_ceil_fixed(right.x, 16 + S) - 1, clip.x1);
+      detail::span<Blend>(canvas, xl, xr, y, shader);
+      left.x += left.step;
+      right.x += right.step;
+    }
+  }
+}
+
+} // namespace pastel
+
+#endif // PASTEL_HPP_
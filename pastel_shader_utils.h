@@ -16,6 +16,12 @@
 // Again, use `#define ..._IMPLEMENTATION` if and only if the
 // implementations are needed in the compilation unit you are working on.
 // 
+// Premultiplied alpha:
+// These shaders return the colors of their context, or linear interpolations
+// of them. If the context colors are premultiplied (see `pastel_color_premultiply`),
+// so are the returned colors: add the PASTEL_SHADER_PREMULTIPLIED flag to the
+// shader and a premultiplied canvas will blend them as is.
+//
 
 #include "pastel.h"
 
@@ -26,6 +32,10 @@ typedef struct {
 } PastelShaderContextMonochrome;
 
 PASTELDEF Color pastel_shader_func_monochrome(int x, int y, void* context);
+PASTELDEF void pastel_shader_func_monochrome_span(int x0, int x1, int y, Color* out, void* context);
+// @brief Monochrome shader flagged as constant, so that rasterizers only run it
+// once per span (and skip blending when the color is opaque).
+PASTELDEF PastelShader pastel_shader_monochrome(PastelShaderContextMonochrome* context);
 
 //
 // Gradient shader 1D.
@@ -38,28 +48,216 @@ typedef struct {
 
 PASTELDEF Color pastel_shader_func_gradient1dx(int x, int y, void* context);
 PASTELDEF Color pastel_shader_func_gradient1dy(int x, int y, void* context);
+PASTELDEF void pastel_shader_func_gradient1dx_span(int x0, int x1, int y, Color* out, void* context);
+PASTELDEF void pastel_shader_func_gradient1dy_span(int x0, int x1, int y, Color* out, void* context);
+// @brief Gradient shaders with both their per pixel and span functions.
+PASTELDEF PastelShader pastel_shader_gradient1dx(PastelShaderContextGradient1D* context);
+PASTELDEF PastelShader pastel_shader_gradient1dy(PastelShaderContextGradient1D* context);
 
 //
-// Gradient shader 2D.
+// Gradient shader 1D with a lookup table of its colors.
+// The table holds the colors of [gradient.min, gradient.max], in a buffer of `lut_capacity`
+// colors provided by the caller: it is built on first use, then the shaders only read it
+// (clamped) instead of dividing for every pixel. It is rebuilt when the gradient changes.
+// Without room for max-min+1 colors, the shaders compute the colors as the ones above.
+// Parallel fills and command lists run the shaders from several threads: build the table
+// beforehand with `pastel_shader_gradient1d_lut_build`.
 typedef struct {
-  Color c1;
-  Color c2;
+  PastelShaderContextGradient1D gradient;
+  Color* lut;
+  size_t lut_capacity;
+  // Gradient the table was built for.
+  PastelShaderContextGradient1D lut_gradient;
+  bool lut_built;
+} PastelShaderContextGradient1DLut;
+
+PASTELDEF PastelShaderContextGradient1DLut pastel_shader_context_gradient1d_lut(PastelShaderContextGradient1D gradient, Color* lut, size_t lut_capacity);
+// @brief Build the lookup table of the context if the gradient changed since it was built.
+// @return false if the buffer is too small (the shaders then compute the colors).
+PASTELDEF bool pastel_shader_gradient1d_lut_build(PastelShaderContextGradient1DLut* context);
+PASTELDEF Color pastel_shader_func_gradient1dx_lut(int x, int y, void* context);
+PASTELDEF Color pastel_shader_func_gradient1dy_lut(int x, int y, void* context);
+PASTELDEF void pastel_shader_func_gradient1dx_lut_span(int x0, int x1, int y, Color* out, void* context);
+PASTELDEF void pastel_shader_func_gradient1dy_lut_span(int x0, int x1, int y, Color* out, void* context);
+// @brief Gradient shaders reading the lookup table of their context.
+PASTELDEF PastelShader pastel_shader_gradient1dx_lut(PastelShaderContextGradient1DLut* context);
+PASTELDEF PastelShader pastel_shader_gradient1dy_lut(PastelShaderContextGradient1DLut* context);
+
+//
+// Gradient shader 2D: bilinear interpolation of the colors of the corners
+// of the rectangle [min, max], clamped outside of it.
+typedef struct {
+  Color c1; // (min.x, min.y)
+  Color c2; // (max.x, min.y)
+  Color c3; // (min.x, max.y)
+  Color c4; // (max.x, max.y)
   Vec2i min;
   Vec2i max;
 } PastelShaderContextGradient2D;
 
+PASTELDEF Color pastel_shader_func_gradient2d(int x, int y, void* context);
+PASTELDEF void pastel_shader_func_gradient2d_span(int x0, int x1, int y, Color* out, void* context);
+// @brief Bilinear gradient shader. Its span function steps the channels in fixed point
+// along the row, without any division per pixel, several pixels at a time with SIMD.
+PASTELDEF PastelShader pastel_shader_gradient2d(PastelShaderContextGradient2D* context);
+
+//
+// Radial gradient shader: from c1 at the center to c2 at `radius` and beyond.
+// The color of a pixel is the one of floor(255*distance/radius)/255 in the lookup table,
+// found from the squared distance with exact integer thresholds (no square root).
+typedef struct {
+  Color c1;
+  Color c2;
+  Vec2i center;
+  int radius;
+  // Built by `pastel_shader_context_gradient_radial`: recreate the context to change the gradient.
+  Color lut[256];
+  // Smallest squared distance of each color of the table.
+  int64_t thresholds[256];
+} PastelShaderContextGradientRadial;
+
+PASTELDEF PastelShaderContextGradientRadial pastel_shader_context_gradient_radial(Color c1, Color c2, Vec2i center, int radius);
+PASTELDEF Color pastel_shader_func_gradient_radial(int x, int y, void* context);
+PASTELDEF void pastel_shader_func_gradient_radial_span(int x0, int x1, int y, Color* out, void* context);
+// @brief Radial gradient shader. Its span function steps the squared distance along
+// the row and walks the thresholds, with neither square root nor division per pixel.
+PASTELDEF PastelShader pastel_shader_gradient_radial(PastelShaderContextGradientRadial* context);
+
+//
+// Conic gradient shader: from c1 to c2 over a turn around the center, clockwise on the
+// screen (the y axis points down) from the direction `start`, in 1/256 of a turn from the x axis.
+// The turn is split into 256 sectors bounded by rays in fixed point (from a sine table):
+// the color of a pixel is the one of its sector, found with cross products (no atan2).
+typedef struct {
+  Color c1;
+  Color c2;
+  Vec2i center;
+  int start;
+  // Built by `pastel_shader_context_gradient_conic`: recreate the context to change the gradient.
+  Color lut[256];
+} PastelShaderContextGradientConic;
+
+PASTELDEF PastelShaderContextGradientConic pastel_shader_context_gradient_conic(Color c1, Color c2, Vec2i center, int start);
+PASTELDEF Color pastel_shader_func_gradient_conic(int x, int y, void* context);
+PASTELDEF void pastel_shader_func_gradient_conic_span(int x0, int x1, int y, Color* out, void* context);
+// @brief Conic gradient shader. Its span function walks the sectors from pixel to pixel.
+PASTELDEF PastelShader pastel_shader_gradient_conic(PastelShaderContextGradientConic* context);
+
+//
+// Texture: its texels are stored in tiles of 8x8 texels, row by row, and the texels
+// of a tile in Z-order (Morton order). The texels around a texel are then close in
+// memory in every direction, so that sampling a rotated or scaled texture, which goes
+// down its columns as much as along its rows, stays in the cache.
+// The caller provides `pastel_texture_size(width, height)` colors for the texels.
+#define PASTEL_TEXTURE_TILE_SIZE 8
+typedef struct {
+  Color* texels;
+  size_t width;
+  size_t height;
+  size_t tiles_x;
+} PastelTexture;
+
+// @brief Number of colors of the texels of a texture, rounded up to whole tiles.
+PASTELDEF size_t pastel_texture_size(size_t width, size_t height);
+PASTELDEF PastelTexture pastel_texture_create(Color* texels, size_t width, size_t height);
+// @brief Store in the texture the row-major image `pixels`, whose rows are `stride` pixels apart.
+PASTELDEF void pastel_texture_upload(PastelTexture* texture, const Color* pixels, size_t stride);
+// @brief Texel (x, y) of the texture, clamped to its edges.
+PASTELDEF Color pastel_texture_texel(const PastelTexture* texture, int x, int y);
+#ifdef STBI_INCLUDE_STB_IMAGE_H
+// @brief Decode an image file with `stb_image.h` (include it before this header) into
+// a texture over `texels`, which must hold `pastel_texture_size(width, height)` colors.
+// @return false if the file cannot be decoded or if `texels` is too small.
+PASTELDEF bool pastel_texture_load(PastelTexture* texture, Color* texels, size_t capacity, const char* file_path);
+#endif // STBI_INCLUDE_STB_IMAGE_H
+
+//
+// Mip chain of a texture: each level is half the size of the previous one (at least 1x1)
+// and each of its texels is the mean of 2x2 texels of the previous level. In Z-order,
+// these are 4 consecutive texels, so a level is a single pass of `pastel_average4_span`.
+// Level 0 is the texture itself, the other levels are stored in caller-provided texels.
+#define PASTEL_MIPMAP_MAX_LEVELS 16
+typedef struct {
+  PastelTexture levels[PASTEL_MIPMAP_MAX_LEVELS];
+  size_t count;
+} PastelMipmap;
+
+// @brief Number of colors of the texels of the levels after level 0 of a texture.
+PASTELDEF size_t pastel_mipmap_size(size_t width, size_t height);
+// @brief Build the mip chain of `texture` in `texels`, which hold `pastel_mipmap_size` colors.
+// Build it again after changing the texels of the texture.
+PASTELDEF PastelMipmap pastel_mipmap_create(PastelTexture* texture, Color* texels);
+
+//
+// Texture shaders: pixel (x, y) samples the texture at the texel coordinates of its center
+//   u = u0 + (x + 0.5)*dudx + (y + 0.5)*dudy
+//   v = v0 + (x + 0.5)*dvdx + (y + 0.5)*dvdy
+// clamped to the edges of the texture, e.g u0 = -p.x, v0 = -p.y, dudx = dvdy = 1 and
+// dvdx = dudy = 0 draw it as is at p. The coordinates are in 16.16 fixed point,
+// stepped by (dudx, dvdx) along a span.
+typedef struct {
+  const PastelTexture* texture;
+  // Mip chain of the texture for `pastel_shader_texture_trilinear`, NULL otherwise.
+  const PastelMipmap* mipmap;
+  // Coordinates of the center of pixel (0, 0).
+  int64_t u;
+  int64_t v;
+  int64_t dudx;
+  int64_t dvdx;
+  int64_t dudy;
+  int64_t dvdy;
+} PastelShaderContextTexture;
+
+PASTELDEF PastelShaderContextTexture pastel_shader_context_texture(const PastelTexture* texture, float u0, float v0, float dudx, float dvdx, float dudy, float dvdy);
+// @brief Same as `pastel_shader_context_texture` on level 0 of a mip chain, for the trilinear shader.
+PASTELDEF PastelShaderContextTexture pastel_shader_context_mipmap(const PastelMipmap* mipmap, float u0, float v0, float dudx, float dvdx, float dudy, float dvdy);
+PASTELDEF Color pastel_shader_func_texture_nearest(int x, int y, void* context);
+PASTELDEF Color pastel_shader_func_texture_bilinear(int x, int y, void* context);
+PASTELDEF void pastel_shader_func_texture_nearest_span(int x0, int x1, int y, Color* out, void* context);
+PASTELDEF void pastel_shader_func_texture_bilinear_span(int x0, int x1, int y, Color* out, void* context);
+PASTELDEF Color pastel_shader_func_texture_trilinear(int x, int y, void* context);
+PASTELDEF void pastel_shader_func_texture_trilinear_span(int x0, int x1, int y, Color* out, void* context);
+// @brief Texture shaders, with the nearest texel or the bilinear interpolation of the 4 nearest ones.
+PASTELDEF PastelShader pastel_shader_texture_nearest(PastelShaderContextTexture* context);
+PASTELDEF PastelShader pastel_shader_texture_bilinear(PastelShaderContextTexture* context);
+// @brief Texture shader for minified draws: the level of detail comes from the texel step
+// between pixels, and the bilinear samples of the 2 nearest levels of the mip chain are
+// interpolated. A texture drawn 4 times smaller then reads level 2, 16 times fewer texels.
+// Without mip chain, it is the bilinear shader.
+PASTELDEF PastelShader pastel_shader_texture_trilinear(PastelShaderContextTexture* context);
+
 
 // ------------------------------------------------------
 // -------------- SHADERS IMPLEMENTATIONS ---------------
 // ------------------------------------------------------
 #ifdef PASTEL_SHADER_UTILS_IMPLEMENTATION
 
+#if defined(PASTEL_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(PASTEL_WASM_SIMD)
+#include <wasm_simd128.h>
+#endif
+
 PASTELDEF Color pastel_shader_func_monochrome(int x, int y, void* context) {
   PASTEL_UNUSED(x); PASTEL_UNUSED(y);
   PastelShaderContextMonochrome* _context = (PastelShaderContextMonochrome*)context;
   return _context->color;
 }
 
+PASTELDEF void pastel_shader_func_monochrome_span(int x0, int x1, int y, Color* out, void* context) {
+  PASTEL_UNUSED(y);
+  PastelShaderContextMonochrome* _context = (PastelShaderContextMonochrome*)context;
+  for (int x = x0; x <= x1; ++x) out[x - x0] = _context->color;
+}
+
+PASTELDEF PastelShader pastel_shader_monochrome(PastelShaderContextMonochrome* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_monochrome, context);
+  shader.run_span = pastel_shader_func_monochrome_span;
+  shader.flags |= PASTEL_SHADER_CONSTANT;
+  return shader;
+}
+
 PASTELDEF Color __pastel_compute_color_grad1d(int v, int vmin, int vmax, Color c1, Color c2) {
   if (v < vmin) v = vmin; if(v > vmax) v = vmax;
 
@@ -97,4 +295,644 @@ PASTELDEF Color pastel_shader_func_gradient1dy(int x, int y, void* context) {
   return color;
 }
 
+PASTELDEF void pastel_shader_func_gradient1dx_span(int x0, int x1, int y, Color* out, void* context) {
+  PASTEL_UNUSED(y);
+  PastelShaderContextGradient1D* _context = (PastelShaderContextGradient1D*)context;
+  for (int x = x0; x <= x1; ++x) {
+    out[x - x0] = __pastel_compute_color_grad1d(x, _context->min, _context->max, _context->c1, _context->c2);
+  }
+}
+
+// The color only depends on the row: compute it once for the whole span.
+PASTELDEF void pastel_shader_func_gradient1dy_span(int x0, int x1, int y, Color* out, void* context) {
+  PastelShaderContextGradient1D* _context = (PastelShaderContextGradient1D*)context;
+  Color color = __pastel_compute_color_grad1d(y, _context->min, _context->max, _context->c1, _context->c2);
+  for (int x = x0; x <= x1; ++x) out[x - x0] = color;
+}
+
+PASTELDEF PastelShader pastel_shader_gradient1dx(PastelShaderContextGradient1D* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_gradient1dx, context);
+  shader.run_span = pastel_shader_func_gradient1dx_span;
+  return shader;
+}
+
+PASTELDEF PastelShader pastel_shader_gradient1dy(PastelShaderContextGradient1D* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_gradient1dy, context);
+  shader.run_span = pastel_shader_func_gradient1dy_span;
+  return shader;
+}
+
+PASTELDEF PastelShaderContextGradient1DLut pastel_shader_context_gradient1d_lut(PastelShaderContextGradient1D gradient, Color* lut, size_t lut_capacity) {
+  PastelShaderContextGradient1DLut context = {
+    .gradient = gradient,
+    .lut = lut,
+    .lut_capacity = lut_capacity,
+    .lut_gradient = { 0, 0, 0, 0 },
+    .lut_built = false
+  };
+  return context;
+}
+
+PASTELDEF bool pastel_shader_gradient1d_lut_build(PastelShaderContextGradient1DLut* context) {
+  const PastelShaderContextGradient1D* g = &context->gradient;
+  const PastelShaderContextGradient1D* built = &context->lut_gradient;
+  if (context->lut_built && g->c1 == built->c1 && g->c2 == built->c2 && g->min == built->min && g->max == built->max) {
+    return true;
+  }
+  context->lut_built = false;
+  if (context->lut == NULL || g->max < g->min || (size_t)g->max - (size_t)g->min >= context->lut_capacity) {
+    return false;
+  }
+  for (int v = g->min; v <= g->max; ++v) {
+    context->lut[v - g->min] = __pastel_compute_color_grad1d(v, g->min, g->max, g->c1, g->c2);
+  }
+  context->lut_gradient = *g;
+  context->lut_built = true;
+  return true;
+}
+
+PASTELDEF Color __pastel_gradient1d_lut_color(PastelShaderContextGradient1DLut* context, int v) {
+  const PastelShaderContextGradient1D* g = &context->gradient;
+  if (!pastel_shader_gradient1d_lut_build(context)) {
+    return __pastel_compute_color_grad1d(v, g->min, g->max, g->c1, g->c2);
+  }
+  if (v < g->min) v = g->min;
+  if (v > g->max) v = g->max;
+  return context->lut[v - g->min];
+}
+
+PASTELDEF Color pastel_shader_func_gradient1dx_lut(int x, int y, void* context) {
+  PASTEL_UNUSED(y);
+  return __pastel_gradient1d_lut_color((PastelShaderContextGradient1DLut*)context, x);
+}
+
+PASTELDEF Color pastel_shader_func_gradient1dy_lut(int x, int y, void* context) {
+  PASTEL_UNUSED(x);
+  return __pastel_gradient1d_lut_color((PastelShaderContextGradient1DLut*)context, y);
+}
+
+// The span is a copy of the table, between the clamped colors of its ends.
+PASTELDEF void pastel_shader_func_gradient1dx_lut_span(int x0, int x1, int y, Color* out, void* context) {
+  PastelShaderContextGradient1DLut* _context = (PastelShaderContextGradient1DLut*)context;
+  if (!pastel_shader_gradient1d_lut_build(_context)) {
+    pastel_shader_func_gradient1dx_span(x0, x1, y, out, &_context->gradient);
+    return;
+  }
+  int min = _context->gradient.min, max = _context->gradient.max;
+  const Color* lut = _context->lut;
+  int x = x0;
+  for (; x <= x1 && x < min; ++x) out[x - x0] = lut[0];
+  int end;
+  PASTEL_MIN2(end, x1, max);
+  if (x <= end) {
+    const Color* src = lut + (x - min);
+    Color* dst = out + (x - x0);
+    for (int i = 0, n = end - x + 1; i < n; ++i) dst[i] = src[i];
+    x = end + 1;
+  }
+  for (; x <= x1; ++x) out[x - x0] = lut[max - min];
+}
+
+PASTELDEF void pastel_shader_func_gradient1dy_lut_span(int x0, int x1, int y, Color* out, void* context) {
+  Color color = __pastel_gradient1d_lut_color((PastelShaderContextGradient1DLut*)context, y);
+  for (int x = x0; x <= x1; ++x) out[x - x0] = color;
+}
+
+PASTELDEF PastelShader pastel_shader_gradient1dx_lut(PastelShaderContextGradient1DLut* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_gradient1dx_lut, context);
+  shader.run_span = pastel_shader_func_gradient1dx_lut_span;
+  return shader;
+}
+
+PASTELDEF PastelShader pastel_shader_gradient1dy_lut(PastelShaderContextGradient1DLut* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_gradient1dy_lut, context);
+  shader.run_span = pastel_shader_func_gradient1dy_lut_span;
+  return shader;
+}
+
+// Channels of the 2D gradient along a row, in 16.16 fixed point (rounding included):
+// channel c of pixel x is (left[c] + step[c]*tx) >> 16, with tx = x - min.x clamped to [0, tx_max].
+// Only the row needs divisions.
+typedef struct {
+  int32_t left[4];
+  int32_t step[4];
+  int tx_max;
+} __PastelGradient2DRow;
+
+PASTELDEF __PastelGradient2DRow __pastel_gradient2d_row(const PastelShaderContextGradient2D* context, int y) {
+  __PastelGradient2DRow row;
+  int dx = context->max.x - context->min.x;
+  int dy = context->max.y - context->min.y;
+  row.tx_max = dx > 0 ? dx : 0;
+  if (dx <= 0) dx = 1;
+  int ty = y - context->min.y;
+  if (dy <= 0) { dy = 1; ty = 0; }
+  if (ty < 0) ty = 0;
+  if (ty > dy) ty = dy;
+  for (int c = 0; c < 4; ++c) {
+    int64_t c1 = (context->c1 >> (8*c)) & 0xFF;
+    int64_t c2 = (context->c2 >> (8*c)) & 0xFF;
+    int64_t c3 = (context->c3 >> (8*c)) & 0xFF;
+    int64_t c4 = (context->c4 >> (8*c)) & 0xFF;
+    int64_t left = c1*65536 + (c3 - c1)*ty*65536/dy;
+    int64_t right = c2*65536 + (c4 - c2)*ty*65536/dy;
+    row.left[c] = (int32_t)left + (1 << 15);
+    row.step[c] = (int32_t)((right - left)/dx);
+  }
+  return row;
+}
+
+// Colors of the n pixels from tx (tx + n - 1 <= tx_max).
+PASTELDEF void __pastel_gradient2d_row_span(const __PastelGradient2DRow* row, int tx, Color* out, int n) {
+  int32_t acc[4];
+  for (int c = 0; c < 4; ++c) acc[c] = row->left[c] + row->step[c]*tx;
+  int i = 0;
+#if defined(PASTEL_SSE2)
+  // The 4 channels of a pixel are the lanes of a vector: 4 pixels per iteration,
+  // narrowed to bytes by saturating packs.
+  if (n >= 4) {
+    __m128i step = _mm_setr_epi32(row->step[0], row->step[1], row->step[2], row->step[3]);
+    __m128i step4 = _mm_slli_epi32(step, 2);
+    __m128i a0 = _mm_setr_epi32(acc[0], acc[1], acc[2], acc[3]);
+    __m128i a1 = _mm_add_epi32(a0, step);
+    __m128i a2 = _mm_add_epi32(a1, step);
+    __m128i a3 = _mm_add_epi32(a2, step);
+    for (; i + 4 <= n; i += 4) {
+      __m128i p01 = _mm_packs_epi32(_mm_srai_epi32(a0, 16), _mm_srai_epi32(a1, 16));
+      __m128i p23 = _mm_packs_epi32(_mm_srai_epi32(a2, 16), _mm_srai_epi32(a3, 16));
+      _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(p01, p23));
+      a0 = _mm_add_epi32(a0, step4);
+      a1 = _mm_add_epi32(a1, step4);
+      a2 = _mm_add_epi32(a2, step4);
+      a3 = _mm_add_epi32(a3, step4);
+    }
+    for (int c = 0; c < 4; ++c) acc[c] = row->left[c] + row->step[c]*(tx + i);
+  }
+#elif defined(PASTEL_WASM_SIMD)
+  if (n >= 4) {
+    v128_t step = wasm_i32x4_make(row->step[0], row->step[1], row->step[2], row->step[3]);
+    v128_t step4 = wasm_i32x4_shl(step, 2);
+    v128_t a0 = wasm_i32x4_make(acc[0], acc[1], acc[2], acc[3]);
+    v128_t a1 = wasm_i32x4_add(a0, step);
+    v128_t a2 = wasm_i32x4_add(a1, step);
+    v128_t a3 = wasm_i32x4_add(a2, step);
+    for (; i + 4 <= n; i += 4) {
+      v128_t p01 = wasm_i16x8_narrow_i32x4(wasm_i32x4_shr(a0, 16), wasm_i32x4_shr(a1, 16));
+      v128_t p23 = wasm_i16x8_narrow_i32x4(wasm_i32x4_shr(a2, 16), wasm_i32x4_shr(a3, 16));
+      wasm_v128_store(out + i, wasm_u8x16_narrow_i16x8(p01, p23));
+      a0 = wasm_i32x4_add(a0, step4);
+      a1 = wasm_i32x4_add(a1, step4);
+      a2 = wasm_i32x4_add(a2, step4);
+      a3 = wasm_i32x4_add(a3, step4);
+    }
+    for (int c = 0; c < 4; ++c) acc[c] = row->left[c] + row->step[c]*(tx + i);
+  }
+#endif
+  for (; i < n; ++i) {
+    Color color = 0;
+    for (int c = 0; c < 4; ++c) {
+      color |= (Color)(acc[c] >> 16) << (8*c);
+      acc[c] += row->step[c];
+    }
+    out[i] = color;
+  }
+}
+
+PASTELDEF Color pastel_shader_func_gradient2d(int x, int y, void* context) {
+  PastelShaderContextGradient2D* _context = (PastelShaderContextGradient2D*)context;
+  __PastelGradient2DRow row = __pastel_gradient2d_row(_context, y);
+  int tx = x - _context->min.x;
+  if (tx < 0) tx = 0;
+  if (tx > row.tx_max) tx = row.tx_max;
+  Color color;
+  __pastel_gradient2d_row_span(&row, tx, &color, 1);
+  return color;
+}
+
+PASTELDEF void pastel_shader_func_gradient2d_span(int x0, int x1, int y, Color* out, void* context) {
+  PastelShaderContextGradient2D* _context = (PastelShaderContextGradient2D*)context;
+  __PastelGradient2DRow row = __pastel_gradient2d_row(_context, y);
+  int min = _context->min.x, max = _context->min.x + row.tx_max;
+  int x = x0;
+  if (x <= x1 && x < min) {
+    Color first;
+    __pastel_gradient2d_row_span(&row, 0, &first, 1);
+    for (; x <= x1 && x < min; ++x) out[x - x0] = first;
+  }
+  int end;
+  PASTEL_MIN2(end, x1, max);
+  if (x <= end) {
+    __pastel_gradient2d_row_span(&row, x - min, out + (x - x0), end - x + 1);
+    x = end + 1;
+  }
+  if (x <= x1) {
+    Color last;
+    __pastel_gradient2d_row_span(&row, row.tx_max, &last, 1);
+    for (; x <= x1; ++x) out[x - x0] = last;
+  }
+}
+
+PASTELDEF PastelShader pastel_shader_gradient2d(PastelShaderContextGradient2D* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_gradient2d, context);
+  shader.run_span = pastel_shader_func_gradient2d_span;
+  return shader;
+}
+
+// Color of t/255 of the way from c1 to c2, for each t of [0, 255].
+PASTELDEF void __pastel_gradient_lut256(Color* lut, Color c1, Color c2) {
+  for (int t = 0; t < 256; ++t) lut[t] = __pastel_compute_color_grad1d(t, 0, 255, c1, c2);
+}
+
+PASTELDEF PastelShaderContextGradientRadial pastel_shader_context_gradient_radial(Color c1, Color c2, Vec2i center, int radius) {
+  PastelShaderContextGradientRadial context;
+  context.c1 = c1;
+  context.c2 = c2;
+  context.center = center;
+  context.radius = radius;
+  __pastel_gradient_lut256(context.lut, c1, c2);
+  // The color t starts at distance t*radius/255: 255^2*d^2 >= t^2*radius^2.
+  // Without radius, every pixel is beyond it.
+  int64_t r2 = radius > 0 ? (int64_t)radius*radius : 0;
+  for (int64_t t = 0; t < 256; ++t) context.thresholds[t] = (t*t*r2 + 255*255 - 1)/(255*255);
+  return context;
+}
+
+// Last color of the table whose threshold is at most d2.
+PASTELDEF int __pastel_gradient_radial_search(const PastelShaderContextGradientRadial* context, int64_t d2) {
+  int lo = 0, hi = 255;
+  while (lo < hi) {
+    int mid = (lo + hi + 1)/2;
+    if (context->thresholds[mid] <= d2) lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
+
+PASTELDEF Color pastel_shader_func_gradient_radial(int x, int y, void* context) {
+  PastelShaderContextGradientRadial* _context = (PastelShaderContextGradientRadial*)context;
+  int64_t dx = x - _context->center.x, dy = y - _context->center.y;
+  return _context->lut[__pastel_gradient_radial_search(_context, dx*dx + dy*dy)];
+}
+
+PASTELDEF void pastel_shader_func_gradient_radial_span(int x0, int x1, int y, Color* out, void* context) {
+  PastelShaderContextGradientRadial* _context = (PastelShaderContextGradientRadial*)context;
+  const int64_t* thresholds = _context->thresholds;
+  int64_t dx = x0 - _context->center.x, dy = y - _context->center.y;
+  int64_t d2 = dx*dx + dy*dy;
+  int t = __pastel_gradient_radial_search(_context, d2);
+  for (int x = x0; x <= x1; ++x) {
+    out[x - x0] = _context->lut[t];
+    // (dx + 1)^2 = dx^2 + 2dx + 1: a pixel further, the distance changed by at most 1,
+    // so the color only moves by a few steps.
+    d2 += 2*dx + 1;
+    ++dx;
+    while (t < 255 && thresholds[t + 1] <= d2) ++t;
+    while (thresholds[t] > d2) --t;
+  }
+}
+
+PASTELDEF PastelShader pastel_shader_gradient_radial(PastelShaderContextGradientRadial* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_gradient_radial, context);
+  shader.run_span = pastel_shader_func_gradient_radial_span;
+  return shader;
+}
+
+// sin(2*pi*i/256) in 1.14 fixed point, for the first quarter of a turn.
+static const int32_t __pastel_sin256_table[65] = {
+  0, 402, 804, 1205, 1606, 2006, 2404, 2801, 3196, 3590, 3981, 4370, 4756,
+  5139, 5520, 5897, 6270, 6639, 7005, 7366, 7723, 8076, 8423, 8765, 9102, 9434,
+  9760, 10080, 10394, 10702, 11003, 11297, 11585, 11866, 12140, 12406, 12665, 12916, 13160,
+  13395, 13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978, 15137, 15286, 15426, 15557,
+  15679, 15791, 15893, 15986, 16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379, 16384
+};
+
+PASTELDEF int32_t __pastel_sin256(int i) {
+  i &= 255;
+  if (i <= 64) return __pastel_sin256_table[i];
+  if (i <= 128) return __pastel_sin256_table[128 - i];
+  if (i <= 192) return -__pastel_sin256_table[i - 128];
+  return -__pastel_sin256_table[256 - i];
+}
+
+// Whether the ray i (at i/256 of a turn) is at or before the direction (dx, dy),
+// both angles taken in [0, 2*pi) from the x axis. The rays of [0, 128) and the
+// directions with dy > 0 (or dy == 0 and dx >= 0) are in the first half turn.
+PASTELDEF bool __pastel_gradient_conic_reached(int i, int64_t dx, int64_t dy) {
+  bool second_half = dy < 0 || (dy == 0 && dx < 0);
+  if (second_half != (i >= 128)) return second_half;
+  int64_t cos = __pastel_sin256(i + 64), sin = __pastel_sin256(i);
+  return cos*dy - sin*dx >= 0;
+}
+
+// Sector of the direction (dx, dy): last ray reached.
+PASTELDEF int __pastel_gradient_conic_search(int64_t dx, int64_t dy) {
+  int lo = 0, hi = 255;
+  while (lo < hi) {
+    int mid = (lo + hi + 1)/2;
+    if (__pastel_gradient_conic_reached(mid, dx, dy)) lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
+
+PASTELDEF PastelShaderContextGradientConic pastel_shader_context_gradient_conic(Color c1, Color c2, Vec2i center, int start) {
+  PastelShaderContextGradientConic context;
+  context.c1 = c1;
+  context.c2 = c2;
+  context.center = center;
+  context.start = start;
+  __pastel_gradient_lut256(context.lut, c1, c2);
+  return context;
+}
+
+PASTELDEF Color pastel_shader_func_gradient_conic(int x, int y, void* context) {
+  PastelShaderContextGradientConic* _context = (PastelShaderContextGradientConic*)context;
+  int64_t dx = x - _context->center.x, dy = y - _context->center.y;
+  int sector = __pastel_gradient_conic_search(dx, dy);
+  return _context->lut[(sector - _context->start) & 255];
+}
+
+// Along a row, the angle moves the same way from pixel to pixel:
+// the sector is walked from the one of the previous pixel.
+PASTELDEF void pastel_shader_func_gradient_conic_span(int x0, int x1, int y, Color* out, void* context) {
+  PastelShaderContextGradientConic* _context = (PastelShaderContextGradientConic*)context;
+  int64_t dx = x0 - _context->center.x, dy = y - _context->center.y;
+  int sector = __pastel_gradient_conic_search(dx, dy);
+  for (int x = x0; x <= x1; ++x, ++dx) {
+    while (sector < 255 && __pastel_gradient_conic_reached(sector + 1, dx, dy)) ++sector;
+    while (!__pastel_gradient_conic_reached(sector, dx, dy)) --sector;
+    out[x - x0] = _context->lut[(sector - _context->start) & 255];
+  }
+}
+
+PASTELDEF PastelShader pastel_shader_gradient_conic(PastelShaderContextGradientConic* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_gradient_conic, context);
+  shader.run_span = pastel_shader_func_gradient_conic_span;
+  return shader;
+}
+
+PASTELDEF size_t pastel_texture_size(size_t width, size_t height) {
+  size_t tiles_x = (width + PASTEL_TEXTURE_TILE_SIZE - 1)/PASTEL_TEXTURE_TILE_SIZE;
+  size_t tiles_y = (height + PASTEL_TEXTURE_TILE_SIZE - 1)/PASTEL_TEXTURE_TILE_SIZE;
+  return tiles_x*tiles_y*PASTEL_TEXTURE_TILE_SIZE*PASTEL_TEXTURE_TILE_SIZE;
+}
+
+PASTELDEF PastelTexture pastel_texture_create(Color* texels, size_t width, size_t height) {
+  PastelTexture texture = {
+    .texels = texels,
+    .width = width,
+    .height = height,
+    .tiles_x = (width + PASTEL_TEXTURE_TILE_SIZE - 1)/PASTEL_TEXTURE_TILE_SIZE
+  };
+  return texture;
+}
+
+// Bits of x in [0, 8) spread to the even bits of the Z-order index.
+static const uint8_t __pastel_morton8[8] = { 0, 1, 4, 5, 16, 17, 20, 21 };
+
+// Index of the texel (x, y), inside the texture.
+PASTELDEF size_t __pastel_texel_index(const PastelTexture* texture, int x, int y) {
+  size_t tile = (size_t)(y >> 3)*texture->tiles_x + (size_t)(x >> 3);
+  return tile*64 + (__pastel_morton8[x & 7] | (__pastel_morton8[y & 7] << 1));
+}
+
+// Fill the texels of the tiles out of the texture with the texels of its edges,
+// so that they can be filtered as the others.
+PASTELDEF void __pastel_texture_pad(PastelTexture* texture) {
+  int w = (int)texture->width, h = (int)texture->height;
+  int tiled_w = (int)texture->tiles_x*PASTEL_TEXTURE_TILE_SIZE;
+  int tiled_h = (h + PASTEL_TEXTURE_TILE_SIZE - 1)/PASTEL_TEXTURE_TILE_SIZE*PASTEL_TEXTURE_TILE_SIZE;
+  for (int y = 0; y < tiled_h; ++y) {
+    int x = y < h ? w : 0;
+    for (; x < tiled_w; ++x) {
+      texture->texels[__pastel_texel_index(texture, x, y)] = pastel_texture_texel(texture, x, y);
+    }
+  }
+}
+
+PASTELDEF void pastel_texture_upload(PastelTexture* texture, const Color* pixels, size_t stride) {
+  for (size_t y = 0; y < texture->height; ++y) {
+    for (size_t x = 0; x < texture->width; ++x) {
+      texture->texels[__pastel_texel_index(texture, (int)x, (int)y)] = pixels[y*stride + x];
+    }
+  }
+  __pastel_texture_pad(texture);
+}
+
+PASTELDEF Color pastel_texture_texel(const PastelTexture* texture, int x, int y) {
+  if (x < 0) x = 0;
+  if (x >= (int)texture->width) x = (int)texture->width - 1;
+  if (y < 0) y = 0;
+  if (y >= (int)texture->height) y = (int)texture->height - 1;
+  return texture->texels[__pastel_texel_index(texture, x, y)];
+}
+
+#ifdef STBI_INCLUDE_STB_IMAGE_H
+PASTELDEF bool pastel_texture_load(PastelTexture* texture, Color* texels, size_t capacity, const char* file_path) {
+  int width, height;
+  if (!stbi_info(file_path, &width, &height, NULL)) return false;
+  if (pastel_texture_size((size_t)width, (size_t)height) > capacity) return false;
+  Color* pixels = (Color*)stbi_load(file_path, &width, &height, NULL, 4);
+  if (pixels == NULL) return false;
+  *texture = pastel_texture_create(texels, (size_t)width, (size_t)height);
+  pastel_texture_upload(texture, pixels, (size_t)width);
+  stbi_image_free(pixels);
+  return true;
+}
+#endif // STBI_INCLUDE_STB_IMAGE_H
+
+PASTELDEF int64_t __pastel_to_fixed16(float f) {
+  double d = (double)f*65536.0;
+  return (int64_t)(d >= 0 ? d + 0.5 : d - 0.5);
+}
+
+PASTELDEF PastelShaderContextTexture pastel_shader_context_texture(const PastelTexture* texture, float u0, float v0, float dudx, float dvdx, float dudy, float dvdy) {
+  PastelShaderContextTexture context = {
+    .texture = texture,
+    .mipmap = NULL,
+    .u = __pastel_to_fixed16(u0 + 0.5f*dudx + 0.5f*dudy),
+    .v = __pastel_to_fixed16(v0 + 0.5f*dvdx + 0.5f*dvdy),
+    .dudx = __pastel_to_fixed16(dudx),
+    .dvdx = __pastel_to_fixed16(dvdx),
+    .dudy = __pastel_to_fixed16(dudy),
+    .dvdy = __pastel_to_fixed16(dvdy)
+  };
+  return context;
+}
+
+PASTELDEF PastelShaderContextTexture pastel_shader_context_mipmap(const PastelMipmap* mipmap, float u0, float v0, float dudx, float dvdx, float dudy, float dvdy) {
+  PastelShaderContextTexture context = pastel_shader_context_texture(&mipmap->levels[0], u0, v0, dudx, dvdx, dudy, dvdy);
+  context.mipmap = mipmap;
+  return context;
+}
+
+PASTELDEF size_t pastel_mipmap_size(size_t width, size_t height) {
+  size_t size = 0;
+  for (size_t level = 1; level < PASTEL_MIPMAP_MAX_LEVELS && (width > 1 || height > 1); ++level) {
+    width = width > 1 ? width/2 : 1;
+    height = height > 1 ? height/2 : 1;
+    size += pastel_texture_size(width, height);
+  }
+  return size;
+}
+
+PASTELDEF PastelMipmap pastel_mipmap_create(PastelTexture* texture, Color* texels) {
+  PastelMipmap mipmap;
+  __pastel_texture_pad(texture);
+  mipmap.levels[0] = *texture;
+  mipmap.count = 1;
+  while (mipmap.count < PASTEL_MIPMAP_MAX_LEVELS) {
+    const PastelTexture* src = &mipmap.levels[mipmap.count - 1];
+    if (src->width <= 1 && src->height <= 1) break;
+    PastelTexture* dst = &mipmap.levels[mipmap.count++];
+    *dst = pastel_texture_create(texels, src->width > 1 ? src->width/2 : 1, src->height > 1 ? src->height/2 : 1);
+    texels += pastel_texture_size(dst->width, dst->height);
+    // The 64 texels of a source tile give a quarter of a destination tile, in Z-order too.
+    size_t src_tiles_y = (src->height + PASTEL_TEXTURE_TILE_SIZE - 1)/PASTEL_TEXTURE_TILE_SIZE;
+    size_t dst_tiles_y = (dst->height + PASTEL_TEXTURE_TILE_SIZE - 1)/PASTEL_TEXTURE_TILE_SIZE;
+    for (size_t ty = 0; ty < src_tiles_y && ty/2 < dst_tiles_y; ++ty) {
+      for (size_t tx = 0; tx < src->tiles_x && tx/2 < dst->tiles_x; ++tx) {
+        const Color* src_tile = src->texels + (ty*src->tiles_x + tx)*64;
+        Color* dst_tile = dst->texels + ((ty/2)*dst->tiles_x + tx/2)*64;
+        pastel_average4_span(dst_tile + 16*((tx & 1) + 2*(ty & 1)), src_tile, 16);
+      }
+    }
+    __pastel_texture_pad(dst);
+  }
+  return mipmap;
+}
+
+PASTELDEF Color __pastel_texture_nearest(const PastelTexture* texture, int64_t u, int64_t v) {
+  int64_t x = u >> 16, y = v >> 16;
+  if (x < 0) x = 0;
+  if (x >= (int64_t)texture->width) x = (int64_t)texture->width - 1;
+  if (y < 0) y = 0;
+  if (y >= (int64_t)texture->height) y = (int64_t)texture->height - 1;
+  return texture->texels[__pastel_texel_index(texture, (int)x, (int)y)];
+}
+
+// c1 + (c2 - c1)*f/256, on the red and blue channels then on the green and alpha ones at once.
+PASTELDEF Color __pastel_lerp_color256(Color c1, Color c2, uint32_t f) {
+  uint32_t rb = ((c1 & 0x00FF00FF)*(256 - f) + (c2 & 0x00FF00FF)*f) >> 8;
+  uint32_t ga = (((c1 >> 8) & 0x00FF00FF)*(256 - f) + ((c2 >> 8) & 0x00FF00FF)*f) >> 8;
+  return (rb & 0x00FF00FF) | ((ga & 0x00FF00FF) << 8);
+}
+
+// The texel centers are at integer + 0.5 coordinates.
+PASTELDEF Color __pastel_texture_bilinear(const PastelTexture* texture, int64_t u, int64_t v) {
+  u -= 1 << 15;
+  v -= 1 << 15;
+  int64_t x = u >> 16, y = v >> 16;
+  uint32_t fx = (uint32_t)(u >> 8) & 0xFF, fy = (uint32_t)(v >> 8) & 0xFF;
+  int64_t w = (int64_t)texture->width, h = (int64_t)texture->height;
+  int x0 = (int)(x < 0 ? 0 : x >= w ? w - 1 : x);
+  int x1 = (int)(x + 1 < 0 ? 0 : x + 1 >= w ? w - 1 : x + 1);
+  int y0 = (int)(y < 0 ? 0 : y >= h ? h - 1 : y);
+  int y1 = (int)(y + 1 < 0 ? 0 : y + 1 >= h ? h - 1 : y + 1);
+  const Color* texels = texture->texels;
+  Color top = __pastel_lerp_color256(texels[__pastel_texel_index(texture, x0, y0)], texels[__pastel_texel_index(texture, x1, y0)], fx);
+  Color bottom = __pastel_lerp_color256(texels[__pastel_texel_index(texture, x0, y1)], texels[__pastel_texel_index(texture, x1, y1)], fx);
+  return __pastel_lerp_color256(top, bottom, fy);
+}
+
+PASTELDEF Color pastel_shader_func_texture_nearest(int x, int y, void* context) {
+  PastelShaderContextTexture* _context = (PastelShaderContextTexture*)context;
+  int64_t u = _context->u + x*_context->dudx + y*_context->dudy;
+  int64_t v = _context->v + x*_context->dvdx + y*_context->dvdy;
+  return __pastel_texture_nearest(_context->texture, u, v);
+}
+
+PASTELDEF Color pastel_shader_func_texture_bilinear(int x, int y, void* context) {
+  PastelShaderContextTexture* _context = (PastelShaderContextTexture*)context;
+  int64_t u = _context->u + x*_context->dudx + y*_context->dudy;
+  int64_t v = _context->v + x*_context->dvdx + y*_context->dvdy;
+  return __pastel_texture_bilinear(_context->texture, u, v);
+}
+
+PASTELDEF void pastel_shader_func_texture_nearest_span(int x0, int x1, int y, Color* out, void* context) {
+  PastelShaderContextTexture* _context = (PastelShaderContextTexture*)context;
+  int64_t u = _context->u + x0*_context->dudx + y*_context->dudy;
+  int64_t v = _context->v + x0*_context->dvdx + y*_context->dvdy;
+  for (int x = x0; x <= x1; ++x, u += _context->dudx, v += _context->dvdx) {
+    out[x - x0] = __pastel_texture_nearest(_context->texture, u, v);
+  }
+}
+
+PASTELDEF void pastel_shader_func_texture_bilinear_span(int x0, int x1, int y, Color* out, void* context) {
+  PastelShaderContextTexture* _context = (PastelShaderContextTexture*)context;
+  int64_t u = _context->u + x0*_context->dudx + y*_context->dudy;
+  int64_t v = _context->v + x0*_context->dvdx + y*_context->dvdy;
+  for (int x = x0; x <= x1; ++x, u += _context->dudx, v += _context->dvdx) {
+    out[x - x0] = __pastel_texture_bilinear(_context->texture, u, v);
+  }
+}
+
+// Level of detail in 8.8 fixed point: log2 of the longest texel step between pixels,
+// along x or y (the texture is affine, so it is the same for every span).
+// The log2 of the squared step is computed bit by bit, by repeated squaring.
+PASTELDEF int __pastel_texture_lod(const PastelShaderContextTexture* context) {
+  int64_t sx = context->dudx*context->dudx + context->dvdx*context->dvdx;
+  int64_t sy = context->dudy*context->dudy + context->dvdy*context->dvdy;
+  uint64_t m = (uint64_t)(sx > sy ? sx : sy) >> 16; // 16.16 squared step
+  if (m <= 1 << 16) return 0;
+  int lod2 = 0; // log2(m) in 8.8 fixed point
+  while (m >= 2 << 16) { m >>= 1; lod2 += 256; }
+  for (int bit = 128; bit > 0; bit >>= 1) {
+    m = (m*m) >> 16;
+    if (m >= 2 << 16) { m >>= 1; lod2 += bit; }
+  }
+  return lod2/2;
+}
+
+PASTELDEF Color __pastel_texture_trilinear(const PastelMipmap* mipmap, int lod, int64_t u, int64_t v) {
+  int level = lod >> 8;
+  if (level >= (int)mipmap->count - 1) {
+    level = (int)mipmap->count - 1;
+    return __pastel_texture_bilinear(&mipmap->levels[level], u >> level, v >> level);
+  }
+  Color c1 = __pastel_texture_bilinear(&mipmap->levels[level], u >> level, v >> level);
+  Color c2 = __pastel_texture_bilinear(&mipmap->levels[level + 1], u >> (level + 1), v >> (level + 1));
+  return __pastel_lerp_color256(c1, c2, (uint32_t)lod & 0xFF);
+}
+
+PASTELDEF Color pastel_shader_func_texture_trilinear(int x, int y, void* context) {
+  PastelShaderContextTexture* _context = (PastelShaderContextTexture*)context;
+  if (_context->mipmap == NULL) return pastel_shader_func_texture_bilinear(x, y, context);
+  int64_t u = _context->u + x*_context->dudx + y*_context->dudy;
+  int64_t v = _context->v + x*_context->dvdx + y*_context->dvdy;
+  return __pastel_texture_trilinear(_context->mipmap, __pastel_texture_lod(_context), u, v);
+}
+
+PASTELDEF void pastel_shader_func_texture_trilinear_span(int x0, int x1, int y, Color* out, void* context) {
+  PastelShaderContextTexture* _context = (PastelShaderContextTexture*)context;
+  if (_context->mipmap == NULL) {
+    pastel_shader_func_texture_bilinear_span(x0, x1, y, out, context);
+    return;
+  }
+  int lod = __pastel_texture_lod(_context);
+  int64_t u = _context->u + x0*_context->dudx + y*_context->dudy;
+  int64_t v = _context->v + x0*_context->dvdx + y*_context->dvdy;
+  for (int x = x0; x <= x1; ++x, u += _context->dudx, v += _context->dvdx) {
+    out[x - x0] = __pastel_texture_trilinear(_context->mipmap, lod, u, v);
+  }
+}
+
+PASTELDEF PastelShader pastel_shader_texture_nearest(PastelShaderContextTexture* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_texture_nearest, context);
+  shader.run_span = pastel_shader_func_texture_nearest_span;
+  return shader;
+}
+
+PASTELDEF PastelShader pastel_shader_texture_bilinear(PastelShaderContextTexture* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_texture_bilinear, context);
+  shader.run_span = pastel_shader_func_texture_bilinear_span;
+  return shader;
+}
+
+PASTELDEF PastelShader pastel_shader_texture_trilinear(PastelShaderContextTexture* context) {
+  PastelShader shader = pastel_shader_create(pastel_shader_func_texture_trilinear, context);
+  shader.run_span = pastel_shader_func_texture_trilinear_span;
+  return shader;
+}
+
 #endif // PASTEL_SHADER_UTILS_IMPLEMENTATION
@@ -7,6 +7,13 @@
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
+#include <math.h>
+#ifdef PASTEL_THREADS
+// Small bands so that the test canvas is split between the threads.
+#define PASTEL_THREAD_BAND_BYTES (4 * 1024)
+#endif
+// Declarations of stb_image before the pastel headers, for `pastel_texture_load`.
+#include "third-party/stb_image.h"
 #define PASTEL_TEST_IMPLEMENTATION
 #include "test.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -58,11 +65,11 @@ bool test_case(const char* file_path, const char* diff_file_path) {
 
     bool failed = false;
     for (size_t y = 0; y < HEIGHT; ++y) {
-      for (size_t x = 0; x < HEIGHT; ++x) {
-        Color p1 = expected_pixels[y * HEIGHT + x];
-        Color p2 = pixels[y * HEIGHT + x];
+      for (size_t x = 0; x < WIDTH; ++x) {
+        Color p1 = expected_pixels[y * WIDTH + x];
+        Color p2 = pixels[y * WIDTH + x];
         if (p1 != p2) {
-          pixels[y * HEIGHT + x] = PIXEL_DIFF_COLOR;
+          pixels[y * WIDTH + x] = PIXEL_DIFF_COLOR;
           failed = true;
         }
       }
@@ -89,6 +96,8 @@ typedef struct {
   void (*run)(void);
   const char* file_path;
   const char* diff_file_path;
+  // Compared to the image of another test case: it is not recorded.
+  bool alias;
 } TestCase;
 
 #define DEFINE_TEST_CASE(name) \
@@ -96,6 +105,17 @@ typedef struct {
   .run = name, \
   .file_path = TEST_DIR_PATH "/" #name ".png", \
   .diff_file_path = TEST_DIFF_DIR_PATH "/diff_" #name ".png", \
+  .alias = false, \
+  }
+
+// Test case which must generate the same image as the test case `image`.
+// Only `image` records it.
+#define DEFINE_TEST_CASE_WITH_IMAGE(name, image) \
+  { \
+  .run = name, \
+  .file_path = TEST_DIR_PATH "/" #image ".png", \
+  .diff_file_path = TEST_DIFF_DIR_PATH "/diff_" #name ".png", \
+  .alias = true, \
   }
 
 void test_fill_rect(void) {
@@ -118,6 +138,27 @@ void test_fill_triangle(void) {
   pastel_test_fill_triangles(&canvas);
 }
 
+// The constant shader fast paths must generate the same images.
+void test_fill_rect_constant(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_fill_rects_constant(&canvas);
+}
+
+void test_fill_circle_constant(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_fill_circles_constant(&canvas);
+}
+
+void test_draw_line_constant(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_draw_lines_constant(&canvas);
+}
+
+void test_fill_triangle_constant(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_fill_triangles_constant(&canvas);
+}
+
 void test_draw_line_with_shader(void) {
   PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
   pastel_test_draw_lines_with_shaders(&canvas);
@@ -133,20 +174,465 @@ void test_gradienty(void) {
   pastel_test_gradienty(&canvas);
 }
 
+// The spans of the gradients must generate the same images.
+void test_gradientx_span(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_gradientx_span(&canvas);
+}
+
+void test_gradienty_span(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_gradienty_span(&canvas);
+}
+
+// The gradients with a lookup table must generate the same images.
+#define GRADIENT_LUT_CAPACITY (WIDTH + 1)
+static Color gradient_lut[GRADIENT_LUT_CAPACITY];
+
+void test_gradientx_lut(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_gradientx_lut(&canvas, gradient_lut, GRADIENT_LUT_CAPACITY);
+}
+
+void test_gradienty_lut(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_gradienty_lut(&canvas, gradient_lut, GRADIENT_LUT_CAPACITY);
+}
+
+// Without room for the table, the colors are computed.
+void test_gradientx_lut_too_small(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_gradientx_lut(&canvas, gradient_lut, WIDTH/2);
+}
+
+void test_gradient2d(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_gradient2d(&canvas, true);
+}
+
+// The span function must generate the same colors as the pixel one.
+void test_gradient2d_per_pixel(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_gradient2d(&canvas, false);
+}
+
+void test_gradient_radial_conic(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_gradient_radial_conic(&canvas, true);
+}
+
+void test_gradient_radial_conic_per_pixel(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_gradient_radial_conic(&canvas, false);
+}
+
+// Index of `color` in the table if it is within 1 of `expected`, -1 otherwise.
+// With `wrap`, the indices 255 and 0 are neighbours.
+static int __lut_index_near(const Color* lut, Color color, int expected, bool wrap) {
+  for (int i = expected - 1; i <= expected + 1; ++i) {
+    int index = wrap ? (i + 256) % 256 : i;
+    if (index >= 0 && index < 256 && lut[index] == color) return index;
+  }
+  return -1;
+}
+
+// The radial and conic gradients avoid sqrt and atan2: their colors must be within
+// one step of the table of the colors computed with them, per pixel and with the spans.
+// The pixels are all marked if a color is further.
+static bool __gradient_radial_conic_ok(Vec2i center, int radius, int start) {
+  const double pi = 3.14159265358979323846;
+  PastelShaderContextGradientRadial radial = pastel_shader_context_gradient_radial(PASTEL_BLACK, PASTEL_WHITE, center, radius);
+  PastelShaderContextGradientConic conic = pastel_shader_context_gradient_conic(PASTEL_BLACK, PASTEL_WHITE, center, start);
+  Color radial_span[WIDTH], conic_span[WIDTH];
+  for (int y = 0; y < HEIGHT; ++y) {
+    pastel_shader_func_gradient_radial_span(0, WIDTH - 1, y, radial_span, &radial);
+    pastel_shader_func_gradient_conic_span(0, WIDTH - 1, y, conic_span, &conic);
+    for (int x = 0; x < WIDTH; ++x) {
+      double dx = x - center.x, dy = y - center.y;
+      double t = radius > 0 ? sqrt(dx*dx + dy*dy)/radius : 1.0;
+      int expected = (int)floor(255*(t < 1.0 ? t : 1.0));
+      if (__lut_index_near(radial.lut, radial_span[x], expected, false) < 0) return false;
+      if (__lut_index_near(radial.lut, pastel_shader_func_gradient_radial(x, y, &radial), expected, false) < 0) return false;
+      if (dx == 0 && dy == 0) continue;
+      // Turns from the direction `start`, clockwise on the screen.
+      double turn = atan2(dy, dx)/(2*pi) - start/256.0;
+      turn -= floor(turn);
+      expected = (int)floor(256*turn) % 256;
+      if (__lut_index_near(conic.lut, conic_span[x], expected, true) < 0) return false;
+      if (__lut_index_near(conic.lut, pastel_shader_func_gradient_conic(x, y, &conic), expected, true) < 0) return false;
+    }
+  }
+  return true;
+}
+
+void test_gradient_radial_conic_error(void) {
+  Vec2i centers[] = { {WIDTH/2, HEIGHT/3}, {0, 0}, {-37, HEIGHT + 21}, {WIDTH + 100, -3} };
+  int radii[] = { 0, 1, 7, 60, 255, 1000 };
+  int starts[] = { 0, 37, 200 };
+  bool gradients_ok = true;
+  for (size_t c = 0; c < sizeof(centers) / sizeof(centers[0]); ++c) {
+    for (size_t r = 0; r < sizeof(radii) / sizeof(radii[0]); ++r) {
+      gradients_ok &= __gradient_radial_conic_ok(centers[c], radii[r], starts[r % 3]);
+    }
+  }
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_gradient_radial_conic(&canvas, true);
+  if (!gradients_ok) {
+    for (size_t i = 0; i < HEIGHT * WIDTH; ++i) pixels[i] = PIXEL_DIFF_COLOR;
+  }
+}
+
+static Color texels[HEIGHT * WIDTH];
+
+void test_texture(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_texture(&canvas, texels, true);
+}
+
+void test_texture_per_pixel(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_texture(&canvas, texels, false);
+}
+
+static Color mip_texels[HEIGHT * WIDTH];
+
+void test_mipmap(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_mipmap(&canvas, texels, mip_texels, true);
+}
+
+void test_mipmap_per_pixel(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_mipmap(&canvas, texels, mip_texels, false);
+}
+
+// Each level of a mipmap must be the mean of the 2x2 texels of the previous level,
+// also for odd and 1 texel wide sizes, where the last texel of a row or column is
+// repeated. The pixels are all marked if a level is wrong.
+static Color mip_source[HEIGHT * WIDTH];
+
+static bool __mipmap_levels_ok(size_t width, size_t height) {
+  if (width * height > HEIGHT * WIDTH
+      || pastel_texture_size(width, height) > HEIGHT * WIDTH
+      || pastel_mipmap_size(width, height) > HEIGHT * WIDTH) return false;
+  uint32_t random = (uint32_t)(width * 31 + height);
+  for (size_t i = 0; i < width * height; ++i) {
+    random = random * 1664525u + 1013904223u;
+    mip_source[i] = random;
+  }
+  PastelTexture texture = pastel_texture_create(texels, width, height);
+  pastel_texture_upload(&texture, mip_source, width);
+  PastelMipmap mipmap = pastel_mipmap_create(&texture, mip_texels);
+  for (size_t k = 1; k < mipmap.count; ++k) {
+    const PastelTexture* source = &mipmap.levels[k - 1];
+    const PastelTexture* level = &mipmap.levels[k];
+    for (int y = 0; y < (int)level->height; ++y) {
+      for (int x = 0; x < (int)level->width; ++x) {
+        Color samples[4] = {
+          pastel_texture_texel(source, 2*x, 2*y), pastel_texture_texel(source, 2*x + 1, 2*y),
+          pastel_texture_texel(source, 2*x, 2*y + 1), pastel_texture_texel(source, 2*x + 1, 2*y + 1),
+        };
+        Color mean = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+          uint32_t sum = 0;
+          for (size_t i = 0; i < 4; ++i) sum += (samples[i] >> shift) & 0xFF;
+          mean |= ((sum + 2) >> 2) << shift;
+        }
+        if (pastel_texture_texel(level, x, y) != mean) return false;
+      }
+    }
+  }
+  const PastelTexture* last = &mipmap.levels[mipmap.count - 1];
+  return last->width == 1 && last->height == 1;
+}
+
+void test_mipmap_levels(void) {
+  static const size_t sizes[][2] = { {128, 96}, {37, 13}, {1, 9}, {20, 1}, {9, 9}, {150, 7} };
+  bool levels_ok = true;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    levels_ok &= __mipmap_levels_ok(sizes[i][0], sizes[i][1]);
+  }
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_mipmap(&canvas, texels, mip_texels, true);
+  if (!levels_ok) {
+    for (size_t i = 0; i < HEIGHT * WIDTH; ++i) pixels[i] = PIXEL_DIFF_COLOR;
+  }
+}
+
+// An image loaded as a texture, sampled texel by texel, must give the image back.
+static void __texture_load(bool bilinear) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  PastelTexture texture;
+  if (!pastel_texture_load(&texture, texels, HEIGHT * WIDTH, TEST_DIR_PATH "/test_gradient2d.png")) {
+    fprintf(stderr, "ERROR: could not load texture %s\n", TEST_DIR_PATH "/test_gradient2d.png");
+    for (size_t i = 0; i < HEIGHT * WIDTH; ++i) pixels[i] = PIXEL_DIFF_COLOR;
+    return;
+  }
+  PastelShaderContextTexture context = pastel_shader_context_texture(&texture, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f);
+  pastel_fill(&canvas, bilinear ? pastel_shader_texture_bilinear(&context) : pastel_shader_texture_nearest(&context));
+}
+
+void test_texture_load_nearest(void) {
+  __texture_load(false);
+}
+
+void test_texture_load_bilinear(void) {
+  __texture_load(true);
+}
+
 void test_alpha_blending(void) {
   PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
   pastel_test_alpha_blending(&canvas);
 }
 
+void test_alpha_blending_constant(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_alpha_blending_constant(&canvas);
+}
+
+void test_alpha_blending_premultiplied(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_alpha_blending_premultiplied(&canvas);
+}
+
+void test_clip(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_clip(&canvas);
+}
+
+void test_fill_triangle_shared_edges(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_fill_triangles_shared_edges(&canvas);
+}
+
+// The batches must generate the same images as one call per primitive.
+void test_fill_rect_batch(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_fill_rects_batch(&canvas);
+}
+
+void test_fill_circle_batch(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_fill_circles_batch(&canvas);
+}
+
+void test_fill_triangle_batch(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_fill_triangles_batch(&canvas);
+}
+
+void test_draw_mesh(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_draw_mesh(&canvas);
+}
+
+// A mesh must generate the same image as one call per triangle.
+void test_draw_mesh_triangles(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_draw_mesh_triangles(&canvas);
+}
+
+void test_draw_mesh_cache_collisions(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_draw_mesh_cache_collisions(&canvas);
+}
+
+void test_draw_mesh_cache_collisions_triangles(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_draw_mesh_cache_collisions_triangles(&canvas);
+}
+
+static float depth[HEIGHT * WIDTH];
+
+void test_depth(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_depth(&canvas, depth);
+}
+
+void test_anti_aliasing(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_anti_aliasing(&canvas);
+}
+
+void test_damage(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_damage(&canvas, NULL);
+}
+
+// Presenting only the damage must give the same image.
+static Color presented[HEIGHT * WIDTH];
+
+void test_damage_presented(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_damage(&canvas, presented);
+}
+
+#define COMMANDS_CAPACITY 64
+static PastelCommand commands[COMMANDS_CAPACITY];
+static uint32_t bins[1024];
+
+void test_deferred(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  PastelCommandList list = pastel_command_list_create(&canvas, commands, COMMANDS_CAPACITY, bins, 1024);
+  pastel_test_deferred(&canvas, &list);
+}
+
+// Deferred rendering must generate the same image as immediate rendering.
+void test_deferred_immediate(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  pastel_test_deferred(&canvas, NULL);
+}
+
+// Without enough memory to bin the commands, nor to record the whole scene.
+void test_deferred_unbinned(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  PastelCommandList list = pastel_command_list_create(&canvas, commands, 5, bins, 4);
+  pastel_test_deferred(&canvas, &list);
+}
+
+#define MSAA_TILES_COUNT 4
+static PastelMsaaTile msaa_tiles[MSAA_TILES_COUNT];
+
+void test_deferred_msaa(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  PastelCommandList list = pastel_command_list_create(&canvas, commands, COMMANDS_CAPACITY, bins, 1024);
+  pastel_command_list_set_msaa(&list, msaa_tiles, 1);
+  pastel_test_deferred(&canvas, &list);
+}
+
+// Rows wider than the image, e.g a locked texture: the primitives must only draw
+// on the first WIDTH pixels of each row.
+#define STRIDE (WIDTH + 13)
+#define STRIDE_PADDING_COLOR 0x12345678
+static Color strided_pixels[HEIGHT * STRIDE];
+
+static PastelCanvas strided_canvas_create(void) {
+  for (size_t i = 0; i < HEIGHT * STRIDE; ++i) strided_pixels[i] = STRIDE_PADDING_COLOR;
+  return pastel_canvas_create_with_stride(strided_pixels, WIDTH, HEIGHT, STRIDE);
+}
+
+// Copy the image to `pixels`, which are all marked if the padding was drawn on.
+static void strided_canvas_copy(void) {
+  bool padding_ok = true;
+  for (size_t y = 0; y < HEIGHT; ++y) {
+    for (size_t x = 0; x < WIDTH; ++x) pixels[y * WIDTH + x] = strided_pixels[y * STRIDE + x];
+    for (size_t x = WIDTH; x < STRIDE; ++x) padding_ok &= strided_pixels[y * STRIDE + x] == STRIDE_PADDING_COLOR;
+  }
+  if (!padding_ok) {
+    for (size_t i = 0; i < HEIGHT * WIDTH; ++i) pixels[i] = PIXEL_DIFF_COLOR;
+  }
+}
+
+void test_clip_strided(void) {
+  PastelCanvas canvas = strided_canvas_create();
+  pastel_test_clip(&canvas);
+  strided_canvas_copy();
+}
+
+void test_anti_aliasing_strided(void) {
+  PastelCanvas canvas = strided_canvas_create();
+  pastel_test_anti_aliasing(&canvas);
+  strided_canvas_copy();
+}
+
+void test_deferred_msaa_strided(void) {
+  PastelCanvas canvas = strided_canvas_create();
+  PastelCommandList list = pastel_command_list_create(&canvas, commands, COMMANDS_CAPACITY, bins, 1024);
+  pastel_command_list_set_msaa(&list, msaa_tiles, 1);
+  pastel_test_deferred(&canvas, &list);
+  strided_canvas_copy();
+}
+
+#ifdef PASTEL_THREADS
+static PastelThreadPool pool;
+
+// The parallel fills must generate the same images as the serial ones.
+void test_gradientx_parallel(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  PastelShaderContextGradient1D context = { PASTEL_RED, PASTEL_GREEN, 0, canvas.width };
+  pastel_fill_parallel(&pool, &canvas, pastel_shader_gradient1dx(&context));
+}
+
+void test_gradienty_parallel(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  PastelShaderContextGradient1D context = { PASTEL_RED, PASTEL_GREEN, 0, canvas.height };
+  pastel_fill_blend_parallel(&pool, &canvas, pastel_shader_gradient1dy(&context));
+}
+
+void test_deferred_parallel(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  PastelCommandList list = pastel_command_list_create(&canvas, commands, COMMANDS_CAPACITY, bins, 1024);
+  list.pool = &pool;
+  pastel_test_deferred(&canvas, &list);
+}
+
+void test_deferred_msaa_parallel(void) {
+  PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+  PastelCommandList list = pastel_command_list_create(&canvas, commands, COMMANDS_CAPACITY, bins, 1024);
+  list.pool = &pool;
+  pastel_command_list_set_msaa(&list, msaa_tiles, MSAA_TILES_COUNT);
+  pastel_test_deferred(&canvas, &list);
+}
+#endif // PASTEL_THREADS
+
 TestCase test_cases[] = {
   DEFINE_TEST_CASE(test_fill_rect),
   DEFINE_TEST_CASE(test_fill_circle),
   DEFINE_TEST_CASE(test_draw_line),
   DEFINE_TEST_CASE(test_fill_triangle),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_fill_rect_constant, test_fill_rect),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_fill_circle_constant, test_fill_circle),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_draw_line_constant, test_draw_line),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_fill_triangle_constant, test_fill_triangle),
+  DEFINE_TEST_CASE(test_fill_triangle_shared_edges),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_fill_rect_batch, test_fill_rect),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_fill_circle_batch, test_fill_circle),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_fill_triangle_batch, test_fill_triangle),
+  DEFINE_TEST_CASE(test_draw_mesh),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_draw_mesh_triangles, test_draw_mesh),
+  DEFINE_TEST_CASE(test_draw_mesh_cache_collisions),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_draw_mesh_cache_collisions_triangles, test_draw_mesh_cache_collisions),
+  DEFINE_TEST_CASE(test_depth),
+  DEFINE_TEST_CASE(test_anti_aliasing),
+  DEFINE_TEST_CASE(test_damage),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_damage_presented, test_damage),
   DEFINE_TEST_CASE(test_draw_line_with_shader),
   DEFINE_TEST_CASE(test_gradientx),
   DEFINE_TEST_CASE(test_gradienty),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_gradientx_span, test_gradientx),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_gradienty_span, test_gradienty),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_gradientx_lut, test_gradientx),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_gradienty_lut, test_gradienty),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_gradientx_lut_too_small, test_gradientx),
+  DEFINE_TEST_CASE(test_gradient2d),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_gradient2d_per_pixel, test_gradient2d),
+  DEFINE_TEST_CASE(test_gradient_radial_conic),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_gradient_radial_conic_per_pixel, test_gradient_radial_conic),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_gradient_radial_conic_error, test_gradient_radial_conic),
+  DEFINE_TEST_CASE(test_texture),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_texture_per_pixel, test_texture),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_texture_load_nearest, test_gradient2d),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_texture_load_bilinear, test_gradient2d),
+  DEFINE_TEST_CASE(test_mipmap),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_mipmap_per_pixel, test_mipmap),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_mipmap_levels, test_mipmap),
   DEFINE_TEST_CASE(test_alpha_blending),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_alpha_blending_constant, test_alpha_blending),
+  DEFINE_TEST_CASE(test_alpha_blending_premultiplied),
+  DEFINE_TEST_CASE(test_clip),
+  DEFINE_TEST_CASE(test_deferred),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_deferred_immediate, test_deferred),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_deferred_unbinned, test_deferred),
+  DEFINE_TEST_CASE(test_deferred_msaa),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_clip_strided, test_clip),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_anti_aliasing_strided, test_anti_aliasing),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_deferred_msaa_strided, test_deferred_msaa),
+#ifdef PASTEL_THREADS
+  DEFINE_TEST_CASE_WITH_IMAGE(test_gradientx_parallel, test_gradientx),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_gradienty_parallel, test_gradienty),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_deferred_parallel, test_deferred),
+  DEFINE_TEST_CASE_WITH_IMAGE(test_deferred_msaa_parallel, test_deferred_msaa),
+#endif
 };
 
 #define TESTS_CASES_COUNT (sizeof(test_cases) / sizeof(test_cases[0]))
@@ -156,8 +642,15 @@ TestCase test_cases[] = {
 int main (int argc, char* argv[]) {
   // argc is always >= 0 and argv[0] is always the program's name.
   bool record = (argc >= 2 && strcmp(argv[1], "record") == 0);
+#ifdef PASTEL_THREADS
+  if (!pastel_thread_pool_init(&pool, 4)) {
+    fprintf(stderr, "ERROR: could not create the thread pool\n");
+    return 1;
+  }
+#endif
 
   for (size_t i = 0; i < TESTS_CASES_COUNT; ++i) {
+    if (record && test_cases[i].alias) continue;
     test_cases[i].run();
     if (record) {
       // Save generated image
@@ -167,5 +660,8 @@ int main (int argc, char* argv[]) {
       if (!test_case(test_cases[i].file_path, test_cases[i].diff_file_path)) return 1;
     }
   }
+#ifdef PASTEL_THREADS
+  pastel_thread_pool_destroy(&pool);
+#endif
   return 0;
 }
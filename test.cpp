@@ -0,0 +1,207 @@
+//
+// Goal of tests: the C++ front end `pastel.hpp` must generate the same images
+// as the C API, so we render the scenes of `test.h` with it and compare them
+// to the images recorded by `test.c`.
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#define PASTEL_IMPLEMENTATION
+#include "pastel.hpp"
+#define STB_IMAGE_IMPLEMENTATION
+#include "third-party/stb_image.h"
+
+#define TEST_DIR_PATH "./test"
+
+#define WIDTH  160
+#define HEIGHT 120
+static Color pixels[HEIGHT * WIDTH];
+
+static bool test_case(const char* file_path) {
+  int expected_width, expected_height;
+  Color* expected_pixels = (Color*)stbi_load(file_path, &expected_width, &expected_height, NULL, 4);
+  if (expected_pixels == NULL) {
+    fprintf(stderr, "ERROR: could not read file %s: %s\n", file_path, strerror(errno));
+    return false;
+  }
+  bool ok = expected_width == WIDTH && expected_height == HEIGHT
+    && memcmp(expected_pixels, pixels, sizeof(pixels)) == 0;
+  stbi_image_free(expected_pixels);
+  if (!ok) {
+    fprintf(stderr, "TEST FAILED: pastel.hpp does not generate the image %s.\n", file_path);
+    return false;
+  }
+  printf("%s OK\n", file_path);
+  return true;
+}
+
+static void fill_bg(PastelCanvas& canvas, Color color) {
+  pastel::fill(canvas, pastel::Monochrome{color});
+}
+
+static void test_fill_rect(PastelCanvas& canvas) {
+  int w = (int)canvas.width, h = (int)canvas.height;
+  fill_bg(canvas, pastel::colors::black);
+  pastel::fill_rect(canvas, {0, 0}, {(size_t)w/2, (size_t)h/3}, pastel::Monochrome{pastel::colors::blue});
+  pastel::fill_rect(canvas, {w/4, h/2}, {(size_t)(2*w)/3, (size_t)h/2}, pastel::Monochrome{pastel::colors::red});
+  pastel::fill_rect(canvas, {w/3, h/4}, {(size_t)w/2, (size_t)h/2}, pastel::Monochrome{pastel::colors::green});
+}
+
+static void test_fill_circle(PastelCanvas& canvas) {
+  int w = (int)canvas.width, h = (int)canvas.height;
+  fill_bg(canvas, pastel::colors::black);
+  pastel::fill_circle(canvas, {0, 0}, w/2, pastel::Monochrome{pastel::colors::red});
+  pastel::fill_circle(canvas, {w/2, h/2}, w/3, pastel::Monochrome{pastel::colors::green});
+  pastel::fill_circle(canvas, {w, h}, h/3, pastel::Monochrome{pastel::colors::blue});
+}
+
+static void test_draw_line(PastelCanvas& canvas) {
+  int w = (int)canvas.width, h = (int)canvas.height;
+  fill_bg(canvas, pastel::colors::black);
+  pastel::Monochrome red = {pastel::colors::red};
+  pastel::Monochrome green = {pastel::colors::green};
+  pastel::Monochrome blue = {pastel::colors::blue};
+  pastel::draw_line(canvas, {0, 0}, {0, h - 1}, red);
+  pastel::draw_line(canvas, {w - 1, 0}, {w - 1, h - 1}, red);
+  pastel::draw_line(canvas, {w/2, h - 1}, {w/2, 0}, green);
+  pastel::draw_line(canvas, {0, h/2}, {w - 1, h/2}, green);
+  pastel::draw_line(canvas, {0, 0}, {w - 1, h - 1}, blue);
+  pastel::draw_line(canvas, {0, h - 1}, {w - 1, 0}, blue);
+}
+
+static void test_fill_triangle(PastelCanvas& canvas) {
+  int w = (int)canvas.width, h = (int)canvas.height;
+  fill_bg(canvas, pastel::colors::black);
+  pastel::fill_triangle(canvas, {0, h/2}, {(w-1)/2, h-1}, {(2*w)/3, 0}, pastel::Monochrome{pastel::colors::red});
+  pastel::fill_triangle(canvas, {0, h/4}, {(2*w)/3, (5*h)/6}, {(3*w)/4, (2*h)/3}, pastel::Monochrome{pastel::colors::green});
+  pastel::fill_triangle(canvas, {(2*w)/3, h/4}, {w-1, h/2}, {(4*w)/5, (3*h)/4}, pastel::Monochrome{pastel::colors::blue});
+}
+
+static void test_gradientx(PastelCanvas& canvas) {
+  pastel::fill(canvas, pastel::Gradient1DX{pastel::colors::red, pastel::colors::green, 0, (int)canvas.width});
+}
+
+static void test_gradienty(PastelCanvas& canvas) {
+  pastel::fill(canvas, pastel::Gradient1DY{pastel::colors::red, pastel::colors::green, 0, (int)canvas.height});
+}
+
+static void test_alpha_blending(PastelCanvas& canvas) {
+  int w = (int)canvas.width, h = (int)canvas.height;
+  fill_bg(canvas, pastel::colors::white);
+  pastel::fill_circle(canvas, {w/3, h/3}, w/4, pastel::Monochrome{pastel::rgba(255, 0, 0, 120)});
+  pastel::fill_rect(canvas, {w/3, h/3}, {(size_t)w/2, (size_t)h/2}, pastel::Monochrome{pastel::rgba(0, 255, 0, 80)});
+}
+
+static void test_clip(PastelCanvas& canvas) {
+  int w = (int)canvas.width, h = (int)canvas.height;
+  fill_bg(canvas, pastel::colors::black);
+  Vec2i pclip = {w/8, h/8};
+  Vec2ui dimclip = {(size_t)(3*w)/4, (size_t)(3*h)/4};
+  pastel_canvas_push_clip(&canvas, &pclip, &dimclip);
+  pastel::fill_circle(canvas, {w/4, h/4}, w/4, pastel::Monochrome{pastel::colors::red});
+  pclip = {w/2, -h};
+  dimclip = {(size_t)w, (size_t)(2*h)};
+  pastel_canvas_push_clip(&canvas, &pclip, &dimclip);
+  pastel::fill_triangle(canvas, {0, h}, {w - 1, 0}, {w - 1, h - 1}, pastel::Monochrome{pastel::colors::green});
+  pastel_canvas_pop_clip(&canvas);
+  pastel::Monochrome blue = {pastel::colors::blue};
+  pastel::draw_line(canvas, {0, 0}, {w - 1, h - 1}, blue);
+  pastel::draw_line(canvas, {0, h/2}, {w - 1, h/2}, blue);
+  pastel::draw_line(canvas, {w/3, 0}, {w/3, h - 1}, blue);
+  pastel::fill_triangle2(canvas, {-w, h - 1}, {w/2, h/2}, {w/4, 2*h}, pastel::Monochrome{pastel::colors::yellow});
+  pastel_canvas_pop_clip(&canvas);
+  pastel::fill_rect(canvas, {(3*w)/4, (3*h)/4}, {(size_t)w, (size_t)h}, pastel::Monochrome{pastel::rgba(255, 255, 255, 128)});
+}
+
+typedef struct {
+  void (*run)(PastelCanvas&);
+  const char* file_path;
+} TestCase;
+
+#define DEFINE_TEST_CASE(name) { name, TEST_DIR_PATH "/" #name ".png" }
+
+static TestCase test_cases[] = {
+  DEFINE_TEST_CASE(test_fill_rect),
+  DEFINE_TEST_CASE(test_fill_circle),
+  DEFINE_TEST_CASE(test_draw_line),
+  DEFINE_TEST_CASE(test_fill_triangle),
+  DEFINE_TEST_CASE(test_gradientx),
+  DEFINE_TEST_CASE(test_gradienty),
+  DEFINE_TEST_CASE(test_alpha_blending),
+  DEFINE_TEST_CASE(test_clip),
+};
+
+#define TESTS_CASES_COUNT (sizeof(test_cases) / sizeof(test_cases[0]))
+
+static Color shader_func_red(int x, int y, void* context) {
+  PASTEL_UNUSED(x); PASTEL_UNUSED(y); PASTEL_UNUSED(context);
+  return pastel::colors::red;
+}
+
+static bool same_damage(const PastelCanvas& c_canvas, const PastelCanvas& cpp_canvas, const char* primitive) {
+  bool ok = c_canvas.damage_count == cpp_canvas.damage_count;
+  for (size_t i = 0; ok && i < c_canvas.damage_count; ++i) {
+    const PastelRect& a = c_canvas.damage[i];
+    const PastelRect& b = cpp_canvas.damage[i];
+    ok = a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1;
+  }
+  if (!ok) fprintf(stderr, "TEST FAILED: pastel::%s does not add the damage of the C API.\n", primitive);
+  return ok;
+}
+
+// The primitives of pastel.hpp must add the same damage as the ones of pastel.h,
+// so that a front end presenting only the damage shows what they draw.
+static bool test_damage(void) {
+  int w = WIDTH, h = HEIGHT;
+  PastelShader c_red = pastel_shader_create(shader_func_red, NULL);
+  pastel::Monochrome red = {pastel::colors::red};
+  Vec2i p1 = {w/5, h/7}, p2 = {(4*w)/5, h/2}, p3 = {w/3, h - 5};
+  Vec2i outside = {-w/4, -h/4};
+  Vec2ui dim = {(size_t)w/3, (size_t)h/4};
+  bool ok = true;
+#define CHECK_DAMAGE(primitive, c_call, cpp_call) \
+  do { \
+    PastelCanvas c_canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT); \
+    PastelCanvas cpp_canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT); \
+    { PastelCanvas* canvas = &c_canvas; c_call; } \
+    { PastelCanvas& canvas = cpp_canvas; cpp_call; } \
+    ok = same_damage(c_canvas, cpp_canvas, primitive) && ok; \
+  } while (0)
+  CHECK_DAMAGE("fill", pastel_fill(canvas, c_red), pastel::fill(canvas, red));
+  CHECK_DAMAGE("fill_blend", pastel_fill_blend(canvas, c_red), pastel::fill_blend(canvas, red));
+  CHECK_DAMAGE("fill_rect", pastel_fill_rect(canvas, &p1, &dim, c_red), pastel::fill_rect(canvas, p1, dim, red));
+  CHECK_DAMAGE("fill_rect", pastel_fill_rect(canvas, &outside, &dim, c_red), pastel::fill_rect(canvas, outside, dim, red));
+  CHECK_DAMAGE("fill_circle", pastel_fill_circle(canvas, &p2, h/3, c_red), pastel::fill_circle(canvas, p2, h/3, red));
+  CHECK_DAMAGE("draw_line", pastel_draw_line(canvas, &p1, &p2, c_red), pastel::draw_line(canvas, p1, p2, red));
+  CHECK_DAMAGE("draw_line", pastel_draw_line(canvas, &p3, &p1, c_red), pastel::draw_line(canvas, p3, p1, red));
+  CHECK_DAMAGE("fill_triangle", pastel_fill_triangle(canvas, &p1, &p2, &p3, c_red), pastel::fill_triangle(canvas, p1, p2, p3, red));
+  CHECK_DAMAGE("fill_triangle2", pastel_fill_triangle2(canvas, &p1, &p2, &p3, c_red), pastel::fill_triangle2(canvas, p1, p2, p3, red));
+  CHECK_DAMAGE("fill_triangle2_oriented", pastel_fill_triangle2_oriented(canvas, &p1, &p3, &p2, c_red),
+               pastel::fill_triangle2_oriented(canvas, p1, p3, p2, red));
+  {
+    PastelCanvas c_canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+    PastelCanvas cpp_canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+    Vec2i clip_p = {w/8, h/8};
+    Vec2ui clip_dim = {(size_t)w/2, (size_t)h/2};
+    pastel_canvas_push_clip(&c_canvas, &clip_p, &clip_dim);
+    pastel_canvas_push_clip(&cpp_canvas, &clip_p, &clip_dim);
+    pastel_fill_triangle(&c_canvas, &p1, &p2, &p3, c_red);
+    pastel_fill_circle(&c_canvas, &p2, h/3, c_red);
+    pastel::fill_triangle(cpp_canvas, p1, p2, p3, red);
+    pastel::fill_circle(cpp_canvas, p2, h/3, red);
+    ok = same_damage(c_canvas, cpp_canvas, "fill_triangle/fill_circle (clipped)") && ok;
+  }
+#undef CHECK_DAMAGE
+  if (ok) printf("damage OK\n");
+  return ok;
+}
+
+int main(void) {
+  for (size_t i = 0; i < TESTS_CASES_COUNT; ++i) {
+    PastelCanvas canvas = pastel_canvas_create(pixels, WIDTH, HEIGHT);
+    test_cases[i].run(canvas);
+    if (!test_case(test_cases[i].file_path)) return 1;
+  }
+  if (!test_damage()) return 1;
+  return 0;
+}
@@ -10,28 +10,67 @@
 #include "pastel.h"
 
 void pastel_test_fill_rects(PastelCanvas* canvas);
+void pastel_test_fill_rects_constant(PastelCanvas* canvas);
 void pastel_test_fill_circles(PastelCanvas* canvas);
+void pastel_test_fill_circles_constant(PastelCanvas* canvas);
 void pastel_test_draw_lines(PastelCanvas* canvas);
+void pastel_test_draw_lines_constant(PastelCanvas* canvas);
 void pastel_test_draw_lines_with_shaders(PastelCanvas* canvas);
 void pastel_test_fill_triangles(PastelCanvas* canvas);
+void pastel_test_fill_triangles_constant(PastelCanvas* canvas);
 void pastel_test_gradientx(PastelCanvas* canvas);
 void pastel_test_gradienty(PastelCanvas* canvas);
+void pastel_test_gradientx_span(PastelCanvas* canvas);
+void pastel_test_gradienty_span(PastelCanvas* canvas);
+void pastel_test_gradientx_lut(PastelCanvas* canvas, Color* lut, size_t lut_capacity);
+void pastel_test_gradienty_lut(PastelCanvas* canvas, Color* lut, size_t lut_capacity);
+void pastel_test_gradient2d(PastelCanvas* canvas, bool span);
+void pastel_test_gradient_radial_conic(PastelCanvas* canvas, bool span);
+// `texels` holds pastel_texture_size(20, 13) colors.
+void pastel_test_texture(PastelCanvas* canvas, Color* texels, bool span);
+// `texels` holds pastel_texture_size(128, 96) colors and `mip_texels` pastel_mipmap_size(128, 96).
+void pastel_test_mipmap(PastelCanvas* canvas, Color* texels, Color* mip_texels, bool span);
+void pastel_test_alpha_blending_premultiplied(PastelCanvas* canvas);
+void pastel_test_clip(PastelCanvas* canvas);
+void pastel_test_deferred(PastelCanvas* canvas, PastelCommandList* list);
+void pastel_test_fill_triangles_shared_edges(PastelCanvas* canvas);
+void pastel_test_fill_rects_batch(PastelCanvas* canvas);
+void pastel_test_fill_circles_batch(PastelCanvas* canvas);
+void pastel_test_fill_triangles_batch(PastelCanvas* canvas);
+void pastel_test_draw_mesh(PastelCanvas* canvas);
+void pastel_test_draw_mesh_triangles(PastelCanvas* canvas);
+void pastel_test_draw_mesh_cache_collisions(PastelCanvas* canvas);
+void pastel_test_draw_mesh_cache_collisions_triangles(PastelCanvas* canvas);
+void pastel_test_depth(PastelCanvas* canvas, float* depth);
+void pastel_test_anti_aliasing(PastelCanvas* canvas);
+void pastel_test_damage(PastelCanvas* canvas, Color* presented);
 
 #endif // PASTEL_TEST_H_
 
 #ifdef PASTEL_TEST_IMPLEMENTATION
 
-void __fill_bg(PastelCanvas* canvas, Color color) {
+// The monochrome shader run pixel by pixel, or with the constant flag and the span
+// of `pastel_shader_monochrome`: both must generate the same images.
+PastelShader __monochrome_shader(PastelShaderContextMonochrome* context, bool constant) {
+  if (constant) return pastel_shader_monochrome(context);
+  return pastel_shader_create(pastel_shader_func_monochrome, context);
+}
+
+void __fill_bg_monochrome(PastelCanvas* canvas, Color color, bool constant) {
   PastelShaderContextMonochrome context = { color };
-  PastelShader shader = {pastel_shader_func_monochrome, &context};
+  PastelShader shader = __monochrome_shader(&context, constant);
   pastel_fill(canvas, shader);
 }
 
-void pastel_test_fill_rects(PastelCanvas* canvas) {
-  __fill_bg(canvas, PASTEL_BLACK);
+void __fill_bg(PastelCanvas* canvas, Color color) {
+  __fill_bg_monochrome(canvas, color, false);
+}
+
+void __test_fill_rects(PastelCanvas* canvas, bool constant) {
+  __fill_bg_monochrome(canvas, PASTEL_BLACK, constant);
 
   PastelShaderContextMonochrome context;
-  PastelShader shader = {pastel_shader_func_monochrome, &context};
+  PastelShader shader = __monochrome_shader(&context, constant);
 
   Vec2i pos; Vec2ui dim;
 
@@ -51,11 +90,19 @@ void pastel_test_fill_rects(PastelCanvas* canvas) {
   pastel_fill_rect(canvas, &pos, &dim, shader);
 }
 
-void pastel_test_fill_circles(PastelCanvas* canvas) {
-  __fill_bg(canvas, PASTEL_BLACK);
+void pastel_test_fill_rects(PastelCanvas* canvas) {
+  __test_fill_rects(canvas, false);
+}
+
+void pastel_test_fill_rects_constant(PastelCanvas* canvas) {
+  __test_fill_rects(canvas, true);
+}
+
+void __test_fill_circles(PastelCanvas* canvas, bool constant) {
+  __fill_bg_monochrome(canvas, PASTEL_BLACK, constant);
 
   PastelShaderContextMonochrome context;
-  PastelShader shader = {pastel_shader_func_monochrome, &context};
+  PastelShader shader = __monochrome_shader(&context, constant);
 
   Vec2i pos;
 
@@ -72,11 +119,19 @@ void pastel_test_fill_circles(PastelCanvas* canvas) {
   pastel_fill_circle(canvas, &pos, canvas->height/3, shader);
 }
 
-void pastel_test_draw_lines(PastelCanvas* canvas) {
-  __fill_bg(canvas, PASTEL_BLACK);
+void pastel_test_fill_circles(PastelCanvas* canvas) {
+  __test_fill_circles(canvas, false);
+}
+
+void pastel_test_fill_circles_constant(PastelCanvas* canvas) {
+  __test_fill_circles(canvas, true);
+}
+
+void __test_draw_lines(PastelCanvas* canvas, bool constant) {
+  __fill_bg_monochrome(canvas, PASTEL_BLACK, constant);
 
   PastelShaderContextMonochrome context;
-  PastelShader shader = {pastel_shader_func_monochrome, &context};
+  PastelShader shader = __monochrome_shader(&context, constant);
 
   Vec2i p1, p2;
 
@@ -115,6 +170,14 @@ void pastel_test_draw_lines(PastelCanvas* canvas) {
 
 }
 
+void pastel_test_draw_lines(PastelCanvas* canvas) {
+  __test_draw_lines(canvas, false);
+}
+
+void pastel_test_draw_lines_constant(PastelCanvas* canvas) {
+  __test_draw_lines(canvas, true);
+}
+
 typedef struct {
   Color c1;
   Color c2;
@@ -171,7 +234,7 @@ void pastel_test_draw_lines_with_shaders(PastelCanvas* canvas) {
   // Middle lines
   Color colors[3] = { PASTEL_RED, PASTEL_GREEN, PASTEL_BLUE };
   ContextLineThreeColors context_middle = {colors, 0, 0};
-  PastelShader shader_middle = {line_shader_func1, &context_middle};
+  PastelShader shader_middle = pastel_shader_create(line_shader_func1, &context_middle);
 
   p1.x = canvas->width/2; p1.y = canvas->height-1;
   p2.x = canvas->width/2; p2.y = 0;
@@ -186,7 +249,7 @@ void pastel_test_draw_lines_with_shaders(PastelCanvas* canvas) {
   ContextTwoColors context_diagonal;
   context_diagonal.width = canvas->width;
   context_diagonal.height = canvas->height;
-  PastelShader shader_diagonal = {line_shader_func2, &context_diagonal};
+  PastelShader shader_diagonal = pastel_shader_create(line_shader_func2, &context_diagonal);
 
   context_diagonal.c1 = PASTEL_RED; context_diagonal.c2 = PASTEL_GREEN;
   p1.x = 0; p1.y = canvas->height-1;
@@ -200,11 +263,11 @@ void pastel_test_draw_lines_with_shaders(PastelCanvas* canvas) {
   pastel_draw_line(canvas, &p1, &p2, shader_diagonal);
 }
 
-void pastel_test_fill_triangles(PastelCanvas* canvas) {
-  __fill_bg(canvas, PASTEL_BLACK);
+void __test_fill_triangles(PastelCanvas* canvas, bool constant) {
+  __fill_bg_monochrome(canvas, PASTEL_BLACK, constant);
 
   PastelShaderContextMonochrome context;
-  PastelShader shader = {pastel_shader_func_monochrome, &context};
+  PastelShader shader = __monochrome_shader(&context, constant);
 
   Vec2i p1, p2, p3;
 
@@ -227,34 +290,646 @@ void pastel_test_fill_triangles(PastelCanvas* canvas) {
   pastel_fill_triangle(canvas, &p1, &p2, &p3, shader);
 }
 
+void pastel_test_fill_triangles(PastelCanvas* canvas) {
+  __test_fill_triangles(canvas, false);
+}
+
+void pastel_test_fill_triangles_constant(PastelCanvas* canvas) {
+  __test_fill_triangles(canvas, true);
+}
+
 void pastel_test_gradientx(PastelCanvas* canvas) {
   PastelShaderContextGradient1D context = { PASTEL_RED, PASTEL_GREEN, 0, canvas->width };
-  PastelShader shader = { pastel_shader_func_gradient1dx, &context };
+  PastelShader shader = pastel_shader_create(pastel_shader_func_gradient1dx, &context);
   pastel_fill(canvas, shader);
 
 }
 
 void pastel_test_gradienty(PastelCanvas* canvas) {
   PastelShaderContextGradient1D context = { PASTEL_RED, PASTEL_GREEN, 0, canvas->height };
-  PastelShader shader = { pastel_shader_func_gradient1dy, &context };
+  PastelShader shader = pastel_shader_create(pastel_shader_func_gradient1dy, &context);
   pastel_fill(canvas, shader);
 }
 
+// Same scenes as `pastel_test_gradientx` and `pastel_test_gradienty`, with the spans
+// of the shaders.
+void pastel_test_gradientx_span(PastelCanvas* canvas) {
+  PastelShaderContextGradient1D context = { PASTEL_RED, PASTEL_GREEN, 0, canvas->width };
+  PastelShader shader = pastel_shader_gradient1dx(&context);
+  pastel_fill(canvas, shader);
+}
+
+void pastel_test_gradienty_span(PastelCanvas* canvas) {
+  PastelShaderContextGradient1D context = { PASTEL_RED, PASTEL_GREEN, 0, canvas->height };
+  PastelShader shader = pastel_shader_gradient1dy(&context);
+  pastel_fill(canvas, shader);
+}
+
+// The table is first built for another gradient, which must not be used afterwards.
+void pastel_test_gradientx_lut(PastelCanvas* canvas, Color* lut, size_t lut_capacity) {
+  PastelShaderContextGradient1D gradient = { PASTEL_GREEN, PASTEL_RED, canvas->width/4, canvas->width/2 };
+  PastelShaderContextGradient1DLut context = pastel_shader_context_gradient1d_lut(gradient, lut, lut_capacity);
+  PastelShader shader = pastel_shader_gradient1dx_lut(&context);
+  pastel_fill(canvas, shader);
+  context.gradient.c1 = PASTEL_RED;
+  context.gradient.c2 = PASTEL_GREEN;
+  context.gradient.min = 0;
+  context.gradient.max = canvas->width;
+  pastel_fill(canvas, shader);
+}
+
+void pastel_test_gradienty_lut(PastelCanvas* canvas, Color* lut, size_t lut_capacity) {
+  PastelShaderContextGradient1D gradient = { PASTEL_RED, PASTEL_GREEN, 0, canvas->height };
+  PastelShaderContextGradient1DLut context = pastel_shader_context_gradient1d_lut(gradient, lut, lut_capacity);
+  pastel_fill(canvas, pastel_shader_gradient1dy_lut(&context));
+}
+
+// Without `span`, the shaders are only run pixel by pixel.
+void pastel_test_gradient2d(PastelCanvas* canvas, bool span) {
+  int w = canvas->width, h = canvas->height;
+  PastelShaderContextGradient2D background = { PASTEL_RED, PASTEL_GREEN, PASTEL_BLUE, PASTEL_YELLOW, { w/8, h/8 }, { (7*w)/8, (7*h)/8 } };
+  PastelShader shader = pastel_shader_gradient2d(&background);
+  if (!span) shader.run_span = NULL;
+  pastel_fill(canvas, shader);
+
+  PastelShaderContextGradient2D disk = { 0x20FFFFFF, 0xFF000000, 0xC0FF00FF, 0x00FFFF00, { w/3, h/4 }, { (2*w)/3 + 1, (3*h)/4 } };
+  shader = pastel_shader_gradient2d(&disk);
+  if (!span) shader.run_span = NULL;
+  Vec2i center = { w/2, h/2 };
+  pastel_fill_circle(canvas, &center, h/3, shader);
+}
+
+void pastel_test_gradient_radial_conic(PastelCanvas* canvas, bool span) {
+  int w = canvas->width, h = canvas->height;
+  Vec2i center = { w/2, h/2 };
+  PastelShaderContextGradientConic conic = pastel_shader_context_gradient_conic(PASTEL_BLUE, PASTEL_YELLOW, center, 64);
+  PastelShader shader = pastel_shader_gradient_conic(&conic);
+  if (!span) shader.run_span = NULL;
+  pastel_fill(canvas, shader);
+
+  Vec2i gauge = { w/4, h/3 };
+  PastelShaderContextGradientRadial radial = pastel_shader_context_gradient_radial(0xFFFFFFFF, 0x400000FF, gauge, h/3);
+  shader = pastel_shader_gradient_radial(&radial);
+  if (!span) shader.run_span = NULL;
+  Vec2i p = { 0, 0 };
+  Vec2ui dim = { (size_t)w/2, (size_t)(2*h)/3 };
+  pastel_fill_rect(canvas, &p, &dim, shader);
+}
+
+// Sprite `texture` (or level 0 of `mipmap`) scaled by `scale` and rotated by the angle
+// of cosine `c` and sine `s` around its corner p, drawn as two triangles with the shader `sampler`.
+static void __draw_sprite(PastelCanvas* canvas, const PastelTexture* texture, const PastelMipmap* mipmap,
+                          Vec2i p, float scale, float c, float s,
+                          PastelShader (*sampler)(PastelShaderContextTexture*), bool span) {
+  // Texel coordinates of the pixels: the inverse rotation and scale.
+  float u0 = -(c*p.x + s*p.y)/scale, v0 = (s*p.x - c*p.y)/scale;
+  PastelShaderContextTexture context = mipmap
+    ? pastel_shader_context_mipmap(mipmap, u0, v0, c/scale, -s/scale, s/scale, c/scale)
+    : pastel_shader_context_texture(texture, u0, v0, c/scale, -s/scale, s/scale, c/scale);
+  if (mipmap) texture = &mipmap->levels[0];
+  PastelShader shader = sampler(&context);
+  if (!span) shader.run_span = NULL;
+  float w = scale*texture->width, h = scale*texture->height;
+  Vec2i corners[4] = {
+    p,
+    { p.x + (int)(c*w + 0.5f), p.y + (int)(s*w + 0.5f) },
+    { p.x + (int)(c*w - s*h + 0.5f), p.y + (int)(s*w + c*h + 0.5f) },
+    { p.x + (int)(-s*h - 0.5f), p.y + (int)(c*h + 0.5f) },
+  };
+  pastel_fill_triangle(canvas, &corners[0], &corners[1], &corners[2], shader);
+  pastel_fill_triangle(canvas, &corners[0], &corners[2], &corners[3], shader);
+}
+
+void pastel_test_texture(PastelCanvas* canvas, Color* texels, bool span) {
+  int w = canvas->width, h = canvas->height;
+  // An icon whose size is not a multiple of the tiles: a checkerboard with a
+  // translucent frame and a diagonal.
+  Color icon[13 * 20];
+  for (int y = 0; y < 13; ++y) {
+    for (int x = 0; x < 20; ++x) {
+      Color color = ((x/4 + y/4) & 1) ? PASTEL_RED : PASTEL_YELLOW;
+      if (x == 0 || y == 0 || x == 19 || y == 12) color = 0x80FFFFFF;
+      if (x == y) color = PASTEL_BLUE;
+      icon[y * 20 + x] = color;
+    }
+  }
+  PastelTexture texture = pastel_texture_create(texels, 20, 13);
+  pastel_texture_upload(&texture, icon, 20);
+
+  PastelShaderContextGradient1D background = { PASTEL_BLACK, PASTEL_WHITE, 0, h };
+  pastel_fill(canvas, pastel_shader_gradient1dy(&background));
+  Vec2i p1 = { 4, 4 };
+  __draw_sprite(canvas, &texture, NULL, p1, 3.0f, 1.0f, 0.0f, pastel_shader_texture_nearest, span);
+  Vec2i p2 = { w/2 + w/8, h/16 };
+  __draw_sprite(canvas, &texture, NULL, p2, 2.5f, 0.866f, 0.5f, pastel_shader_texture_nearest, span);
+  Vec2i p3 = { w/4, h/2 };
+  __draw_sprite(canvas, &texture, NULL, p3, 2.5f, 0.866f, -0.5f, pastel_shader_texture_bilinear, span);
+  Vec2i p4 = { (3*w)/4, h/2 };
+  __draw_sprite(canvas, &texture, NULL, p4, 1.7f, 0.0f, 1.0f, pastel_shader_texture_bilinear, span);
+}
+
+// Thumbnails of a texture with fine details: sampled with the nearest texel they alias,
+// with the trilinear shader they read small levels of the mip chain.
+void pastel_test_mipmap(PastelCanvas* canvas, Color* texels, Color* mip_texels, bool span) {
+  int w = canvas->width, h = canvas->height;
+  static Color image[96 * 128];
+  for (int y = 0; y < 96; ++y) {
+    for (int x = 0; x < 128; ++x) {
+      Color color;
+      if (x < 64) color = ((x ^ y) & 1) ? PASTEL_WHITE : PASTEL_BLACK;
+      else color = ((x + y)/3 & 1) ? PASTEL_RED : PASTEL_BLUE;
+      image[y * 128 + x] = color;
+    }
+  }
+  PastelTexture texture = pastel_texture_create(texels, 128, 96);
+  pastel_texture_upload(&texture, image, 128);
+  PastelMipmap mipmap = pastel_mipmap_create(&texture, mip_texels);
+
+  PastelShaderContextGradient1D background = { PASTEL_YELLOW, PASTEL_GREEN, 0, w };
+  pastel_fill(canvas, pastel_shader_gradient1dx(&background));
+  Vec2i p1 = { w/16, h/8 };
+  __draw_sprite(canvas, &texture, NULL, p1, 0.5f, 0.94f, 0.342f, pastel_shader_texture_nearest, span);
+  Vec2i p2 = { w/2 + w/16, h/8 };
+  __draw_sprite(canvas, NULL, &mipmap, p2, 0.5f, 0.94f, 0.342f, pastel_shader_texture_trilinear, span);
+  Vec2i p3 = { w/16, (2*h)/3 };
+  __draw_sprite(canvas, &texture, NULL, p3, 0.3f, 1.0f, 0.0f, pastel_shader_texture_nearest, span);
+  Vec2i p4 = { w/4 + w/16, (2*h)/3 };
+  __draw_sprite(canvas, NULL, &mipmap, p4, 0.3f, 1.0f, 0.0f, pastel_shader_texture_trilinear, span);
+  Vec2i p5 = { w/2 + w/16, (2*h)/3 };
+  __draw_sprite(canvas, NULL, &mipmap, p5, 0.11f, 1.0f, 0.0f, pastel_shader_texture_trilinear, span);
+  // Magnified, it is the bilinear shader on level 0.
+  Vec2i p6 = { (3*w)/4 - 8, (2*h)/3 };
+  __draw_sprite(canvas, NULL, &mipmap, p6, 1.5f, 1.0f, 0.0f, pastel_shader_texture_trilinear, span);
+}
+
+void __test_alpha_blending(PastelCanvas* canvas, bool constant) {
+  __fill_bg_monochrome(canvas, PASTEL_WHITE, constant);
+
+  PastelShaderContextMonochrome context;
+  PastelShader shader = __monochrome_shader(&context, constant);
+
+  Vec2i pcircle = { canvas->width/3, canvas->height/3 };
+  size_t r = { canvas->width/4 } ; 
+  context.color = PASTEL_RGBA(255, 0, 0, 120);
+  pastel_fill_circle(canvas, &pcircle, r, shader);
+
+  context.color = PASTEL_RGBA(0, 255, 0, 80);
+  Vec2i prect = { canvas->width/3, canvas->height/3 };
+  Vec2ui dim = { canvas->width/2, canvas->height/2 };
+  pastel_fill_rect(canvas, &prect, &dim, shader);
+}
+
 void pastel_test_alpha_blending(PastelCanvas* canvas) {
+  __test_alpha_blending(canvas, false);
+}
+
+void pastel_test_alpha_blending_constant(PastelCanvas* canvas) {
+  __test_alpha_blending(canvas, true);
+}
+
+// Same scene as `pastel_test_alpha_blending`, drawn on a premultiplied canvas
+// with premultiplied shader colors.
+void pastel_test_alpha_blending_premultiplied(PastelCanvas* canvas) {
+  canvas->premultiplied = true;
   __fill_bg(canvas, PASTEL_WHITE);
 
   PastelShaderContextMonochrome context;
-  PastelShader shader = { pastel_shader_func_monochrome, &context };
+  PastelShader shader = pastel_shader_monochrome(&context);
+  shader.flags |= PASTEL_SHADER_PREMULTIPLIED;
 
   Vec2i pcircle = { canvas->width/3, canvas->height/3 };
   size_t r = { canvas->width/4 } ; 
   context.color = PASTEL_RGBA(255, 0, 0, 120);
+  context.color = pastel_color_premultiply(context.color);
   pastel_fill_circle(canvas, &pcircle, r, shader);
 
   context.color = PASTEL_RGBA(0, 255, 0, 80);
+  context.color = pastel_color_premultiply(context.color);
   Vec2i prect = { canvas->width/3, canvas->height/3 };
   Vec2ui dim = { canvas->width/2, canvas->height/2 };
   pastel_fill_rect(canvas, &prect, &dim, shader);
+
+  pastel_canvas_unpremultiply(canvas);
+}
+
+// Primitives crossing two nested clip rectangles.
+void pastel_test_clip(PastelCanvas* canvas) {
+  __fill_bg(canvas, PASTEL_BLACK);
+
+  PastelShaderContextMonochrome context;
+  PastelShader shader = pastel_shader_monochrome(&context);
+
+  int w = canvas->width, h = canvas->height;
+  Vec2i pclip = { w/8, h/8 };
+  Vec2ui dimclip = { (3*w)/4, (3*h)/4 };
+  pastel_canvas_push_clip(canvas, &pclip, &dimclip);
+
+  context.color = PASTEL_RED;
+  Vec2i pcircle = { w/4, h/4 };
+  pastel_fill_circle(canvas, &pcircle, w/4, shader);
+
+  // The second clip rectangle is intersected with the first one.
+  pclip.x = w/2; pclip.y = -h;
+  dimclip.x = w; dimclip.y = 2*h;
+  pastel_canvas_push_clip(canvas, &pclip, &dimclip);
+
+  context.color = PASTEL_GREEN;
+  Vec2i p1 = { 0, h }, p2 = { w - 1, 0 }, p3 = { w - 1, h - 1 };
+  pastel_fill_triangle(canvas, &p1, &p2, &p3, shader);
+
+  pastel_canvas_pop_clip(canvas);
+
+  context.color = PASTEL_BLUE;
+  Vec2i l1 = { 0, 0 }, l2 = { w - 1, h - 1 };
+  pastel_draw_line(canvas, &l1, &l2, shader);
+  l1.y = h/2; l2.y = h/2;
+  pastel_draw_line(canvas, &l1, &l2, shader);
+  l1.x = w/3; l1.y = 0; l2.x = w/3; l2.y = h - 1;
+  pastel_draw_line(canvas, &l1, &l2, shader);
+
+  context.color = PASTEL_YELLOW;
+  Vec2i t1 = { -w, h - 1 }, t2 = { w/2, h/2 }, t3 = { w/4, 2*h };
+  pastel_fill_triangle2(canvas, &t1, &t2, &t3, shader);
+
+  pastel_canvas_pop_clip(canvas);
+
+  context.color = 0x80FFFFFF;
+  Vec2i prect = { (3*w)/4, (3*h)/4 };
+  Vec2ui dim = { w, h };
+  pastel_fill_rect(canvas, &prect, &dim, shader);
+}
+
+// Overlapping primitives crossing the tiles of the deferred renderer.
+// They are recorded in @param list and rendered, or drawn immediately if it is NULL:
+// both must give the same image.
+void pastel_test_deferred(PastelCanvas* canvas, PastelCommandList* list) {
+  PastelShaderContextMonochrome bg = { PASTEL_BLACK };
+  PastelShaderContextMonochrome red = { 0xA00000FF };
+  PastelShaderContextMonochrome green = { 0x7800FF00 };
+  PastelShaderContextMonochrome blue = { PASTEL_BLUE };
+  PastelShaderContextMonochrome yellow = { 0x6400FFFF };
+  PastelShaderContextGradient1D gradient = { 0x28FFFFFF, 0xC8FF0000, 0, canvas->width };
+
+  int w = canvas->width, h = canvas->height;
+  Vec2i p1, p2, p3;
+  Vec2ui dim;
+  Vec2i pclip = { w/10, h/10 };
+  Vec2ui dimclip = { (4*w)/5, (4*h)/5 };
+
+  if (list) pastel_command_list_fill(list, pastel_shader_monochrome(&bg));
+  else      pastel_fill(canvas, pastel_shader_monochrome(&bg));
+
+  for (int i = 0; i < 8; ++i) {
+    p1.x = (i * w)/8; p1.y = (i * h)/10;
+    if (list) pastel_command_list_fill_circle(list, &p1, w/5, pastel_shader_monochrome(&red));
+    else      pastel_fill_circle(canvas, &p1, w/5, pastel_shader_monochrome(&red));
+
+    p1.x = w - (i * w)/7; p1.y = (i * h)/8 - h/6;
+    dim.x = w/4; dim.y = h/3;
+    if (list) pastel_command_list_fill_rect(list, &p1, &dim, pastel_shader_monochrome(&green));
+    else      pastel_fill_rect(canvas, &p1, &dim, pastel_shader_monochrome(&green));
+  }
+
+  pastel_canvas_push_clip(canvas, &pclip, &dimclip);
+
+  p1.x = -w/4; p1.y = h/3; p2.x = w/2; p2.y = h + h/4; p3.x = w + w/5; p3.y = -h/5;
+  if (list) pastel_command_list_fill_triangle(list, &p1, &p2, &p3, pastel_shader_monochrome(&yellow));
+  else      pastel_fill_triangle(canvas, &p1, &p2, &p3, pastel_shader_monochrome(&yellow));
+
+  p1.x = w/3; p1.y = h/5; p2.x = w/5; p2.y = (4*h)/5; p3.x = (5*w)/6; p3.y = (2*h)/3;
+  if (list) pastel_command_list_fill_triangle2_oriented(list, &p1, &p2, &p3, pastel_shader_monochrome(&green));
+  else      pastel_fill_triangle2_oriented(canvas, &p1, &p2, &p3, pastel_shader_monochrome(&green));
+
+  // Back-facing: the oriented triangle draws nothing.
+  p1.x = w/3 + w/10; p1.y = h/10; p2.x = (5*w)/6 + w/10; p2.y = (2*h)/3 - h/10; p3.x = w/5 + w/10; p3.y = (4*h)/5 - h/10;
+  if (list) pastel_command_list_fill_triangle2_oriented(list, &p1, &p2, &p3, pastel_shader_monochrome(&blue));
+  else      pastel_fill_triangle2_oriented(canvas, &p1, &p2, &p3, pastel_shader_monochrome(&blue));
+
+  p1.x = (4*w)/5; p1.y = 0; p2.x = w; p2.y = h;
+  p3.x = w/2; p3.y = h/2;
+  if (list) pastel_command_list_fill_triangle2(list, &p1, &p2, &p3, pastel_shader_monochrome(&red));
+  else      pastel_fill_triangle2(canvas, &p1, &p2, &p3, pastel_shader_monochrome(&red));
+
+  if (list) pastel_command_list_fill_blend(list, pastel_shader_gradient1dx(&gradient));
+  else      pastel_fill_blend(canvas, pastel_shader_gradient1dx(&gradient));
+
+  pastel_canvas_pop_clip(canvas);
+
+  for (int i = 0; i < 6; ++i) {
+    p1.x = 0; p1.y = (i * h)/6;
+    p2.x = w - 1; p2.y = h - 1 - (i * h)/5;
+    if (list) pastel_command_list_draw_line(list, &p1, &p2, pastel_shader_monochrome(&blue));
+    else      pastel_draw_line(canvas, &p1, &p2, pastel_shader_monochrome(&blue));
+  }
+  p1.x = (2*w)/3; p1.y = -h; p2.x = (2*w)/3; p2.y = 2*h;
+  if (list) pastel_command_list_draw_line(list, &p1, &p2, pastel_shader_monochrome(&blue));
+  else      pastel_draw_line(canvas, &p1, &p2, pastel_shader_monochrome(&blue));
+  p1.x = 3; p1.y = 5; p2.x = 5; p2.y = h - 1;
+  if (list) pastel_command_list_draw_line(list, &p1, &p2, pastel_shader_monochrome(&blue));
+  else      pastel_draw_line(canvas, &p1, &p2, pastel_shader_monochrome(&blue));
+
+  if (list) pastel_command_list_render(list);
+}
+
+// A translucent mesh of triangles sharing edges, with subpixel vertices:
+// thanks to the fill rule, every pixel of the mesh is blended exactly once.
+void pastel_test_fill_triangles_shared_edges(PastelCanvas* canvas) {
+  __fill_bg(canvas, PASTEL_BLACK);
+
+  PastelShaderContextMonochrome context = { 0x80FFFFFF };
+  PastelShader shader = pastel_shader_monochrome(&context);
+
+  const int S = PASTEL_SUBPIXEL_BITS;
+  int w = canvas->width << S, h = canvas->height << S;
+  // Grid of 4x3 jittered vertices, each cell cut in 2 triangles.
+  Vec2i grid[4][5];
+  for (int j = 0; j < 4; ++j) {
+    for (int i = 0; i < 5; ++i) {
+      grid[j][i].x = (i * w)/4 + ((i * 7 + j * 3) % 5 - 2) * (w/64);
+      grid[j][i].y = (j * h)/3 + ((i * 3 + j * 5) % 7 - 3) * (h/64) + 3;
+    }
+  }
+  for (int j = 0; j < 3; ++j) {
+    for (int i = 0; i < 4; ++i) {
+      pastel_fill_triangle_subpixel(canvas, &grid[j][i], &grid[j+1][i], &grid[j][i+1], shader);
+      pastel_fill_triangle_subpixel(canvas, &grid[j][i+1], &grid[j+1][i], &grid[j+1][i+1], shader);
+    }
+  }
+
+  // Fan of integer triangles around the center.
+  context.color = 0x80E86056;
+  Vec2i center = { canvas->width/2, canvas->height/2 };
+  Vec2i fan[6] = {
+    { canvas->width/2, 10 }, { (3*canvas->width)/4, canvas->height/3 }, { (2*canvas->width)/3, canvas->height - 15 },
+    { canvas->width/3, canvas->height - 10 }, { canvas->width/5, canvas->height/2 }, { canvas->width/3, canvas->height/5 },
+  };
+  for (int i = 0; i < 6; ++i) {
+    pastel_fill_triangle(canvas, &center, &fan[i], &fan[(i + 1) % 6], shader);
+  }
+}
+
+// Same scene as `pastel_test_fill_rects`, drawn with a batch.
+void pastel_test_fill_rects_batch(PastelCanvas* canvas) {
+  __fill_bg(canvas, PASTEL_BLACK);
+  int w = canvas->width, h = canvas->height;
+  int x[3] = { 0, w/4, w/3 };
+  int y[3] = { 0, h/2, h/4 };
+  int dimx[3] = { w/2, (2*w)/3, w/2 };
+  int dimy[3] = { h/3, h/2, h/2 };
+  Color colors[3] = { PASTEL_BLUE, PASTEL_RED, PASTEL_GREEN };
+  PastelRectBatch batch = { x, y, dimx, dimy, colors, 3 };
+  pastel_fill_rects(canvas, &batch);
+}
+
+// Same scene as `pastel_test_fill_circles`, drawn with a batch.
+void pastel_test_fill_circles_batch(PastelCanvas* canvas) {
+  __fill_bg(canvas, PASTEL_BLACK);
+  int w = canvas->width, h = canvas->height;
+  int x[3] = { 0, w/2, w };
+  int y[3] = { 0, h/2, h };
+  int r[3] = { w/2, w/3, h/3 };
+  Color colors[3] = { PASTEL_RED, PASTEL_GREEN, PASTEL_BLUE };
+  PastelCircleBatch batch = { x, y, r, colors, 3 };
+  pastel_fill_circles(canvas, &batch);
+}
+
+// Same scene as `pastel_test_fill_triangles`, drawn with a batch.
+void pastel_test_fill_triangles_batch(PastelCanvas* canvas) {
+  __fill_bg(canvas, PASTEL_BLACK);
+  int w = canvas->width, h = canvas->height;
+  int x0[3] = { 0, 0, (2*w)/3 };
+  int y0[3] = { h/2, h/4, h/4 };
+  int x1[3] = { (w-1)/2, (2*w)/3, w-1 };
+  int y1[3] = { h-1, (5*h)/6, h/2 };
+  int x2[3] = { (2*w)/3, (3*w)/4, (4*w)/5 };
+  int y2[3] = { 0, (2*h)/3, (3*h)/4 };
+  Color colors[3] = { PASTEL_RED, PASTEL_GREEN, PASTEL_BLUE };
+  PastelTriangleBatch batch = { x0, y0, x1, y1, x2, y2, colors, 3 };
+  pastel_fill_triangles(canvas, &batch);
+}
+
+// Mesh scene: an indexed grid, a strip and a fan of translucent triangles, partly clipped.
+// With `per_triangle`, each triangle is drawn with `pastel_fill_triangle` instead.
+void __draw_mesh(PastelCanvas* canvas, bool per_triangle) {
+  __fill_bg(canvas, PASTEL_BLACK);
+
+  PastelShaderContextMonochrome context = { 0x80FFFFFF };
+  PastelShader shader = pastel_shader_monochrome(&context);
+
+  int w = canvas->width, h = canvas->height;
+  Vec2i pclip = { 0, 0 };
+  Vec2ui dimclip = { w - 10, h - 1 };
+  pastel_canvas_push_clip(canvas, &pclip, &dimclip);
+
+  // Grid of 5x4 jittered vertices, the last column out of the clip rectangle.
+  Vec2i grid[4 * 5];
+  uint32_t grid_indices[3 * 4 * 6];
+  size_t count = 0;
+  for (int j = 0; j < 4; ++j) {
+    for (int i = 0; i < 5; ++i) {
+      grid[j * 5 + i].x = (i * (w + 20))/4 + ((i * 7 + j * 3) % 5 - 2) * 2;
+      grid[j * 5 + i].y = (j * h)/3 + ((i * 3 + j * 5) % 7 - 3) * 2;
+    }
+  }
+  for (uint32_t j = 0; j < 3; ++j) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      uint32_t v = j * 5 + i;
+      grid_indices[count++] = v;     grid_indices[count++] = v + 5; grid_indices[count++] = v + 1;
+      grid_indices[count++] = v + 1; grid_indices[count++] = v + 5; grid_indices[count++] = v + 6;
+    }
+  }
+
+  // Strip along the bottom, vertices in order.
+  Vec2i strip[8];
+  for (int i = 0; i < 8; ++i) {
+    strip[i].x = (i * w)/7;
+    strip[i].y = (i % 2) ? h - 5 : (3*h)/4 + (i % 3) * 3;
+  }
+
+  // Fan around the center; the last index closes it.
+  Vec2i fan[7] = {
+    { w/2, h/2 }, { w/2, 10 }, { (3*w)/4, h/3 }, { (2*w)/3, h - 15 },
+    { w/3, h - 10 }, { w/5, h/2 }, { w/3, h/5 },
+  };
+  uint32_t fan_indices[8] = { 0, 1, 2, 3, 4, 5, 6, 1 };
+
+  if (per_triangle) {
+    for (size_t k = 0; k < count; k += 3) {
+      pastel_fill_triangle(canvas, &grid[grid_indices[k]], &grid[grid_indices[k + 1]], &grid[grid_indices[k + 2]], shader);
+    }
+    context.color = 0x8056E860;
+    for (size_t k = 0; k + 2 < 8; ++k) {
+      pastel_fill_triangle(canvas, &strip[k], &strip[k + 1], &strip[k + 2], shader);
+    }
+    context.color = 0x80E86056;
+    for (size_t k = 0; k + 2 < 8; ++k) {
+      pastel_fill_triangle(canvas, &fan[0], &fan[fan_indices[k + 1]], &fan[fan_indices[k + 2]], shader);
+    }
+  } else {
+    pastel_draw_mesh(canvas, grid, 4 * 5, grid_indices, count, shader);
+    context.color = 0x8056E860;
+    pastel_draw_mesh_strip(canvas, strip, 8, NULL, 8, shader);
+    context.color = 0x80E86056;
+    pastel_draw_mesh_fan(canvas, fan, 7, fan_indices, 8, shader);
+  }
+
+  pastel_canvas_pop_clip(canvas);
+}
+
+void pastel_test_draw_mesh(PastelCanvas* canvas) {
+  __draw_mesh(canvas, false);
+}
+
+// Same scene as `pastel_test_draw_mesh`, drawn one triangle at a time.
+void pastel_test_draw_mesh_triangles(PastelCanvas* canvas) {
+  __draw_mesh(canvas, true);
+}
+
+// Triangles whose vertices are PASTEL_MESH_CACHE_SIZE indices apart, so that each
+// vertex takes the cache slot of another vertex of the same triangle.
+static void __draw_mesh_cache_collisions(PastelCanvas* canvas, bool per_triangle) {
+  __fill_bg(canvas, PASTEL_BLACK);
+
+  PastelShaderContextMonochrome context;
+  PastelShader shader = pastel_shader_monochrome(&context);
+  int w = canvas->width, h = canvas->height;
+
+  // Three rows of vertices, row r starting at index r * N.
+  enum { N = PASTEL_MESH_CACHE_SIZE, COLUMNS = 9 };
+  Vec2i verts[3 * N] = {0};
+  for (int r = 0; r < 3; ++r) {
+    for (int i = 0; i < COLUMNS; ++i) {
+      verts[r * N + i].x = (i * (w - 1))/(COLUMNS - 1) + ((i * 5 + r * 3) % 7 - 3);
+      verts[r * N + i].y = 5 + (r * (h - 10))/2 + ((i * 3 + r) % 5 - 2) * 3;
+    }
+  }
+  uint32_t indices[2 * 6 * (COLUMNS - 1)];
+  size_t count = 0;
+  for (uint32_t r = 0; r < 2; ++r) {
+    for (uint32_t i = 0; i + 1 < COLUMNS; ++i) {
+      uint32_t v = r * N + i;
+      indices[count++] = v;     indices[count++] = v + 1;     indices[count++] = v + N;
+      indices[count++] = v + 1; indices[count++] = v + N + 1; indices[count++] = v + N;
+    }
+  }
+
+  Color colors[2] = { PASTEL_RED, PASTEL_BLUE };
+  for (size_t k = 0; k < count; k += 6) {
+    context.color = colors[(k / 6) % 2];
+    if (per_triangle) {
+      pastel_fill_triangle(canvas, &verts[indices[k]], &verts[indices[k + 1]], &verts[indices[k + 2]], shader);
+      pastel_fill_triangle(canvas, &verts[indices[k + 3]], &verts[indices[k + 4]], &verts[indices[k + 5]], shader);
+    } else {
+      pastel_draw_mesh(canvas, verts, 3 * N, &indices[k], 6, shader);
+    }
+  }
+}
+
+void pastel_test_draw_mesh_cache_collisions(PastelCanvas* canvas) {
+  __draw_mesh_cache_collisions(canvas, false);
+}
+
+// Same scene as `pastel_test_draw_mesh_cache_collisions`, drawn one triangle at a time.
+void pastel_test_draw_mesh_cache_collisions_triangles(PastelCanvas* canvas) {
+  __draw_mesh_cache_collisions(canvas, true);
+}
+
+// Intersecting triangles drawn in any order, sorted by a depth plane of canvas->width floats per row.
+void pastel_test_depth(PastelCanvas* canvas, float* depth) {
+  __fill_bg(canvas, PASTEL_BLACK);
+  pastel_canvas_attach_depth(canvas, depth, canvas->width);
+  pastel_canvas_clear_depth(canvas, 1.0f);
+
+  PastelShaderContextMonochrome context;
+  PastelShader shader = pastel_shader_monochrome(&context);
+  int w = canvas->width, h = canvas->height;
+
+  // A translucent triangle in front, drawn first: what is behind it is then hidden.
+  context.color = 0x80FFFFFF;
+  Vec2i a0 = { w/2, h/2 }, a1 = { w - 1, h/2 }, a2 = { (3*w)/4, h - 1 };
+  pastel_fill_triangle_depth(canvas, &a0, 0.1f, &a1, 0.1f, &a2, 0.1f, shader);
+
+  // Two triangles crossing each other.
+  context.color = PASTEL_RED;
+  Vec2i b0 = { 0, 0 }, b1 = { w - 1, h/3 }, b2 = { w/4, h - 1 };
+  pastel_fill_triangle_depth(canvas, &b0, 0.2f, &b1, 0.8f, &b2, 0.5f, shader);
+  context.color = PASTEL_GREEN;
+  Vec2i c0 = { w - 1, 0 }, c1 = { 0, h/3 }, c2 = { (3*w)/4, h - 1 };
+  pastel_fill_triangle_depth(canvas, &c0, 0.2f, &c1, 0.8f, &c2, 0.5f, shader);
+
+  // Behind everything, only visible on the background.
+  PastelShaderContextGradient1D gradient = { PASTEL_BLUE, PASTEL_YELLOW, 0, w };
+  Vec2i d0 = { 0, h/2 }, d1 = { w - 1, h/2 - 20 }, d2 = { w/2, h - 1 };
+  pastel_fill_triangle_depth(canvas, &d0, 0.9f, &d1, 0.9f, &d2, 0.9f, pastel_shader_gradient1dx(&gradient));
+
+  pastel_canvas_attach_depth(canvas, NULL, 0);
+}
+
+void pastel_test_anti_aliasing(PastelCanvas* canvas) {
+  __fill_bg(canvas, PASTEL_BLACK);
+
+  PastelShaderContextMonochrome context;
+  PastelShader shader = pastel_shader_monochrome(&context);
+  int w = canvas->width, h = canvas->height;
+
+  context.color = PASTEL_RED;
+  Vec2i center = { w/4, h/3 };
+  pastel_fill_circle_aa(canvas, &center, h/4, shader);
+  context.color = 0x80FFFFFF;
+  center.x = w/2; center.y = h/2;
+  pastel_fill_circle_aa(canvas, &center, h/5, shader);
+
+  context.color = PASTEL_GREEN;
+  Vec2i p1 = { w/2, 5 }, p2 = { w - 5, h/2 }, p3 = { (2*w)/3, h - 3 };
+  pastel_fill_triangle_aa(canvas, &p1, &p2, &p3, shader);
+  context.color = 0xA0E86056;
+  p1.x = 3; p1.y = h - 3; p2.x = w/3; p2.y = h/2; p3.x = (3*w)/5; p3.y = h - 20;
+  pastel_fill_triangle_aa(canvas, &p1, &p2, &p3, shader);
+
+  // Lines of every slope around a point
+  context.color = PASTEL_WHITE;
+  Vec2i origin = { (3*w)/4, h/4 };
+  int dirs[12][2] = { { 8, 0 }, { 8, 3 }, { 8, 8 }, { 3, 8 }, { 0, 8 }, { -3, 8 },
+                      { -8, 5 }, { -8, -1 }, { -8, -8 }, { -2, -8 }, { 5, -8 }, { 8, -6 } };
+  for (int i = 0; i < 12; ++i) {
+    Vec2i end = { origin.x + dirs[i][0] * 3, origin.y + dirs[i][1] * 3 };
+    pastel_draw_line_aa(canvas, &origin, &end, shader);
+  }
+}
+
+// Two frames: a full one, then a few primitives on top of it.
+// With `presented`, the frames are presented there like a front end would do: the whole
+// first frame, then only the damage of the second one. It is then copied back to the canvas.
+void pastel_test_damage(PastelCanvas* canvas, Color* presented) {
+  pastel_test_fill_triangles(canvas);
+  size_t w = canvas->width, h = canvas->height;
+  if (presented) {
+    for (size_t i = 0; i < w * h; ++i) presented[i] = canvas->pixels[i];
+  }
+  pastel_canvas_clear_damage(canvas);
+
+  PastelShaderContextMonochrome context = { PASTEL_WHITE };
+  PastelShader shader = pastel_shader_monochrome(&context);
+  Vec2i p1 = { 10, 10 }, p2 = { 30, 25 }, p3 = { 15, 40 };
+  Vec2ui dim = { 12, 8 };
+  pastel_fill_rect(canvas, &p1, &dim, shader);
+  pastel_fill_rect(canvas, &p2, &dim, shader); // merged with the first one
+  p1.x = w - 20; p1.y = h - 20;
+  pastel_fill_circle(canvas, &p1, 15, shader);
+  p1.x = w/2; p1.y = 5; p2.x = w/2 + 30; p2.y = 12;
+  pastel_draw_line(canvas, &p1, &p2, shader);
+  p1.x = 5; p1.y = h - 5; p2.x = 40; p2.y = h - 30; p3.x = 50; p3.y = h - 2;
+  pastel_fill_triangle_aa(canvas, &p1, &p2, &p3, shader);
+
+  if (presented) {
+    for (size_t i = 0; i < canvas->damage_count; ++i) {
+      const PastelRect* r = &canvas->damage[i];
+      for (int y = r->y0; y <= r->y1; ++y) {
+        for (int x = r->x0; x <= r->x1; ++x) presented[y * w + x] = canvas->pixels[y * w + x];
+      }
+    }
+    for (size_t i = 0; i < w * h; ++i) canvas->pixels[i] = presented[i];
+  }
 }
 
 #endif // PASTEL_TEST_IMPLEMENTATION